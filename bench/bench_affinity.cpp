@@ -0,0 +1,61 @@
+// Prepared statement hits and misses with several hot statements on a pool.
+// usage: bench_affinity [connections] [statements] [threads] [queries per thread] [affinity wait us]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+int main(int argc, char** argv) {
+
+	int n_connections = argc > 1 ? std::atoi(argv[1]) : 16;
+	int n_statements = argc > 2 ? std::atoi(argv[2]) : 8;
+	int n_threads = argc > 3 ? std::atoi(argv[3]) : 8;
+	int n_queries = argc > 4 ? std::atoi(argv[4]) : 2000;
+
+	mock_pg_server::options server_options;
+	server_options.rtt_us = 100;
+	mock_pg_server server(server_options);
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	pg_pool_options options;
+	options.n_connections = n_connections;
+	if (argc > 5) {
+		options.affinity_wait_us = std::atoi(argv[5]);
+	}
+
+	async_pg pg(server.connection_params());
+	pg.start(options);
+
+	auto t0 = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < n_threads; ++t) {
+		threads.emplace_back([&pg, t, n_statements, n_queries] {
+			for (int i = 0; i < n_queries; ++i) {
+				int k = (t + i) % n_statements;
+				pg.execute_prepared("stmt_" + std::to_string(k), "select " + std::to_string(k) + " + $1", { pg_param::int32(i) }).get();
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	pg_stats s = pg.stats();
+	pg.stop();
+	server.stop();
+
+	std::printf("connections=%d statements=%d threads=%d affinity_wait_us=%d\n", n_connections, n_statements, n_threads, options.affinity_wait_us);
+	std::printf("qps      %.0f\n", s.queries_completed / elapsed);
+	std::printf("hits     %llu\n", (unsigned long long)s.prepared_hits);
+	std::printf("misses   %llu (at most %d without affinity misses)\n", (unsigned long long)s.prepared_misses, n_connections * n_statements);
+	return 0;
+}
@@ -0,0 +1,67 @@
+// N statements as one execute_batch against N separate execute calls.
+// usage: bench_batch [rtt us] [connections] [rounds]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+int main(int argc, char** argv) {
+
+	mock_pg_server::options server_options;
+	server_options.rtt_us = argc > 1 ? std::atoi(argv[1]) : 1000;
+	int n_connections = argc > 2 ? std::atoi(argv[2]) : 4;
+	int rounds = argc > 3 ? std::atoi(argv[3]) : 50;
+
+	mock_pg_server server(server_options);
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	async_pg pg(server.connection_params());
+	pg.start(n_connections);
+	for (int i = 0; i < n_connections; ++i) {
+		pg.execute("select 1").get();
+	}
+
+	std::printf("rtt=%dus connections=%d, ms per group of statements\n", server_options.rtt_us, n_connections);
+	std::printf("%6s %12s %12s %12s\n", "n", "execute", "batch", "batch+tx");
+
+	for (int n : { 20, 50, 200 }) {
+
+		std::vector<pg_statement> statements;
+		for (int i = 0; i < n; ++i) {
+			statements.emplace_back("insert_audit", "insert into audit values ($1)", std::list<pg_param>{ pg_param::int32(i) });
+		}
+
+		double ms[3] = { 0, 0, 0 };
+		for (int r = 0; r < rounds; ++r) {
+
+			auto t0 = std::chrono::steady_clock::now();
+			std::vector<std::future<std::list<pg_result>>> futures;
+			for (auto& st : statements) {
+				futures.push_back(pg.execute_prepared(st.name(), st.sql(), st.params()));
+			}
+			for (auto& f : futures) {
+				f.get();
+			}
+			auto t1 = std::chrono::steady_clock::now();
+			pg.execute_batch(statements).get();
+			auto t2 = std::chrono::steady_clock::now();
+			pg.execute_batch(statements, true).get();
+			auto t3 = std::chrono::steady_clock::now();
+
+			ms[0] += std::chrono::duration<double, std::milli>(t1 - t0).count();
+			ms[1] += std::chrono::duration<double, std::milli>(t2 - t1).count();
+			ms[2] += std::chrono::duration<double, std::milli>(t3 - t2).count();
+		}
+
+		std::printf("%6d %12.2f %12.2f %12.2f\n", n, ms[0] / rounds, ms[1] / rounds, ms[2] / rounds);
+	}
+
+	pg.stop();
+	server.stop();
+	return 0;
+}
@@ -0,0 +1,173 @@
+// Decoding of result values: text parsed with atoi and friends, text through pg_result::get,
+// and binary through pg_result::get. The decode runs use results built in memory with integer,
+// bigint, double, timestamptz and uuid columns, then a query against the mock server reads
+// an integer column in both formats end to end.
+// usage: bench_binary [rows]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+namespace {
+
+	const int n_cols = 5;
+	const Oid oids[n_cols] = { 23, 20, 701, 1184, 2950 };
+
+	double ms_since(std::chrono::steady_clock::time_point t0) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	}
+
+	void put(char* p, uint64_t value, int size) {
+		for (int i = size - 1; i >= 0; --i) {
+			p[i] = (char)value;
+			value >>= 8;
+		}
+	}
+
+	pg_result make_result(int rows, pg_format format) {
+		PGresult* res = PQmakeEmptyPGresult(nullptr, PGRES_TUPLES_OK);
+		PGresAttDesc attrs[n_cols];
+		const char* names[n_cols] = { "i", "b", "d", "t", "u" };
+		for (int c = 0; c < n_cols; ++c) {
+			attrs[c] = PGresAttDesc{ (char*)names[c], 0, 0, (int)format, oids[c], -1, -1 };
+		}
+		PQsetResultAttrs(res, n_cols, attrs);
+
+		for (int r = 0; r < rows; ++r) {
+			int64_t us = 768000000000000LL + r * 1000001LL;	// 2024-05-03 plus r seconds and microseconds
+			double d = r * 0.25;
+			if (format == pg_format::binary) {
+				char b[16];
+				put(b, (uint32_t)r, 4);
+				PQsetvalue(res, r, 0, b, 4);
+				put(b, (uint64_t)r * 1000003, 8);
+				PQsetvalue(res, r, 1, b, 8);
+				uint64_t bits;
+				std::memcpy(&bits, &d, 8);
+				put(b, bits, 8);
+				PQsetvalue(res, r, 2, b, 8);
+				put(b, (uint64_t)us, 8);
+				PQsetvalue(res, r, 3, b, 8);
+				put(b, 0x0123456789abcdefULL, 8);
+				put(b + 8, (uint64_t)r, 8);
+				PQsetvalue(res, r, 4, b, 16);
+			}
+			else {
+				char v[64];
+				int n = std::snprintf(v, sizeof(v), "%d", r);
+				PQsetvalue(res, r, 0, v, n);
+				n = std::snprintf(v, sizeof(v), "%lld", (long long)r * 1000003);
+				PQsetvalue(res, r, 1, v, n);
+				n = std::snprintf(v, sizeof(v), "%.17g", d);
+				PQsetvalue(res, r, 2, v, n);
+				time_t s = (time_t)(us / 1000000 + 946684800);
+				tm t;
+				gmtime_r(&s, &t);
+				n = std::snprintf(v, sizeof(v), "%04d-%02d-%02d %02d:%02d:%02d.%06d+00", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+					t.tm_hour, t.tm_min, t.tm_sec, (int)(us % 1000000));
+				PQsetvalue(res, r, 3, v, n);
+				n = std::snprintf(v, sizeof(v), "01234567-89ab-cdef-0000-%012x", r);
+				PQsetvalue(res, r, 4, v, n);
+			}
+		}
+		return pg_result(res);
+	}
+
+	// the hand written parsing a caller does on text results
+	double parse_text(pg_result& res) {
+		double sum = 0;
+		for (int r = 0; r < res.rows_count(); ++r) {
+			sum += std::atoi(res.get_value(r, 0));
+			sum += std::atoll(res.get_value(r, 1));
+			sum += std::strtod(res.get_value(r, 2), nullptr);
+			tm t{};
+			int us = 0;
+			std::sscanf(res.get_value(r, 3), "%d-%d-%d %d:%d:%d.%d", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec, &us);
+			t.tm_year -= 1900;
+			t.tm_mon -= 1;
+			sum += timegm(&t) + us * 1e-6;
+			unsigned u[5];
+			std::sscanf(res.get_value(r, 4), "%8x-%4x-%4x-%4x-%12x", &u[0], &u[1], &u[2], &u[3], &u[4]);
+			sum += u[4];
+		}
+		return sum;
+	}
+
+	double get_values(pg_result& res) {
+		double sum = 0;
+		for (int r = 0; r < res.rows_count(); ++r) {
+			sum += res.get<int32_t>(r, 0);
+			sum += res.get<int64_t>(r, 1);
+			sum += res.get<double>(r, 2);
+			sum += std::chrono::duration<double>(res.get<std::chrono::system_clock::time_point>(r, 3).time_since_epoch()).count();
+			auto u = res.get<pg_uuid>(r, 4).bytes;
+			sum += (uint32_t)u[12] << 24 | u[13] << 16 | u[14] << 8 | u[15];
+		}
+		return sum;
+	}
+
+	void report(const char* mode, int rows, double ms, double check) {
+		std::printf("%14s %10d %10.1f %12.1f %14.0f\n", mode, rows, ms, ms * 1e6 / rows / n_cols, check);
+	}
+
+}
+
+int main(int argc, char** argv) {
+
+	int rows = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+	std::printf("rows=%d cols=%d\n", rows, n_cols);
+	std::printf("%14s %10s %10s %12s %14s\n", "mode", "rows", "ms", "ns/value", "checksum");
+
+	{
+		pg_result text = make_result(rows, pg_format::text);
+		pg_result binary = make_result(rows, pg_format::binary);
+
+		auto t0 = std::chrono::steady_clock::now();
+		double check = parse_text(text);
+		report("text atoi", rows, ms_since(t0), check);
+
+		t0 = std::chrono::steady_clock::now();
+		check = get_values(text);
+		report("text get", rows, ms_since(t0), check);
+
+		t0 = std::chrono::steady_clock::now();
+		check = get_values(binary);
+		report("binary get", rows, ms_since(t0), check);
+	}
+
+	mock_pg_server::options server_options;
+	server_options.rows = rows;
+	mock_pg_server server(server_options);
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	pg_pool_options options;
+	options.n_connections = 1;
+	async_pg pg(server.connection_params());
+	pg.start(options).get();
+
+	std::printf("\nend to end, one integer column\n");
+	std::printf("%14s %10s %10s %12s %14s\n", "mode", "rows", "ms", "ns/row", "checksum");
+	for (pg_format format : { pg_format::text, pg_format::binary }) {
+		auto t0 = std::chrono::steady_clock::now();
+		auto results = pg.execute("SELECT n FROM big", {}, {}, false, format).get();
+		double sum = 0;
+		for (auto& res : results) {
+			for (int r = 0; r < res.rows_count(); ++r) {
+				sum += res.get<int32_t>(r, 0);
+			}
+		}
+		double ms = ms_since(t0);
+		std::printf("%14s %10d %10.1f %12.1f %14.0f\n", format == pg_format::text ? "text" : "binary", rows, ms, ms * 1e6 / rows, sum);
+	}
+
+	pg.stop();
+	server.stop();
+	return 0;
+}
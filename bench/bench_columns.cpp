@@ -0,0 +1,184 @@
+// Aggregation of a result: row by row with atoi, row by row with pg_result::get, and through
+// pg_columns, converted once then summed over plain arrays. The results are built in memory
+// with integer, bigint, double and timestamptz columns, one value in ten null, in text and binary format.
+// usage: bench_columns [rows]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include "async_pg/async_pg.hpp"
+
+namespace {
+
+	const int n_cols = 4;
+	const Oid oids[n_cols] = { pg_int4_oid, pg_int8_oid, pg_float8_oid, pg_timestamptz_oid };
+	const char* names[n_cols] = { "qty", "amount", "price", "at" };
+
+	struct totals {
+		int64_t qty = 0;
+		int64_t amount = 0;
+		double price = 0;
+		int64_t last = std::numeric_limits<int64_t>::min();
+		double check() const { return qty + amount + price + last; }
+	};
+
+	double ms_since(std::chrono::steady_clock::time_point t0) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	}
+
+	void put(char* p, uint64_t value, int size) {
+		for (int i = size - 1; i >= 0; --i) {
+			p[i] = (char)value;
+			value >>= 8;
+		}
+	}
+
+	pg_result make_result(int rows, pg_format format) {
+		PGresult* res = PQmakeEmptyPGresult(nullptr, PGRES_TUPLES_OK);
+		PGresAttDesc attrs[n_cols];
+		for (int c = 0; c < n_cols; ++c) {
+			attrs[c] = PGresAttDesc{ (char*)names[c], 0, 0, (int)format, oids[c], -1, -1 };
+		}
+		PQsetResultAttrs(res, n_cols, attrs);
+
+		for (int r = 0; r < rows; ++r) {
+			int32_t qty = r % 100;
+			int64_t amount = (int64_t)r * 7919 - 1000000;
+			double price = r * 0.25;
+			int64_t us = 768000000000000LL + r * 1000001LL;
+			if (format == pg_format::binary) {
+				char b[8];
+				put(b, (uint32_t)qty, 4);
+				PQsetvalue(res, r, 0, r % 10 ? b : nullptr, r % 10 ? 4 : -1);
+				put(b, (uint64_t)amount, 8);
+				PQsetvalue(res, r, 1, b, 8);
+				uint64_t bits;
+				std::memcpy(&bits, &price, 8);
+				put(b, bits, 8);
+				PQsetvalue(res, r, 2, b, 8);
+				put(b, (uint64_t)us, 8);
+				PQsetvalue(res, r, 3, b, 8);
+			}
+			else {
+				char v[64];
+				int n = std::snprintf(v, sizeof(v), "%d", qty);
+				PQsetvalue(res, r, 0, r % 10 ? v : nullptr, r % 10 ? n : -1);
+				n = std::snprintf(v, sizeof(v), "%lld", (long long)amount);
+				PQsetvalue(res, r, 1, v, n);
+				n = std::snprintf(v, sizeof(v), "%.17g", price);
+				PQsetvalue(res, r, 2, v, n);
+				time_t s = (time_t)(us / 1000000 + 946684800);
+				tm t;
+				gmtime_r(&s, &t);
+				n = std::snprintf(v, sizeof(v), "%04d-%02d-%02d %02d:%02d:%02d.%06d+00", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+					t.tm_hour, t.tm_min, t.tm_sec, (int)(us % 1000000));
+				PQsetvalue(res, r, 3, v, n);
+			}
+		}
+		return pg_result(res);
+	}
+
+	// text only
+	totals by_hand(const pg_result& res) {
+		totals t;
+		for (int r = 0; r < res.rows_count(); ++r) {
+			t.qty += std::atoi(res.get_value(r, 0));
+			t.amount += std::atoll(res.get_value(r, 1));
+			t.price += std::strtod(res.get_value(r, 2), nullptr);
+			tm tm{};
+			int us = 0;
+			std::sscanf(res.get_value(r, 3), "%d-%d-%d %d:%d:%d.%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &us);
+			tm.tm_year -= 1900;
+			tm.tm_mon -= 1;
+			int64_t at = (int64_t)timegm(&tm) * 1000000 + us;
+			t.last = at > t.last ? at : t.last;
+		}
+		return t;
+	}
+
+	totals with_get(const pg_result& res) {
+		totals t;
+		for (int r = 0; r < res.rows_count(); ++r) {
+			if (!res.is_null(r, 0)) {
+				t.qty += res.get<int32_t>(r, 0);
+			}
+			t.amount += res.get<int64_t>(r, 1);
+			t.price += res.get<double>(r, 2);
+			int64_t at = std::chrono::duration_cast<std::chrono::microseconds>(res.get<std::chrono::system_clock::time_point>(r, 3).time_since_epoch()).count();
+			t.last = at > t.last ? at : t.last;
+		}
+		return t;
+	}
+
+	// null entries hold 0, the sums need no bitmap
+	totals aggregate(const pg_columns& columns) {
+		totals t;
+		std::size_t n = columns.rows_count();
+		const pg_column& qty_column = columns.column("qty");
+		const int32_t* qty = qty_column.values<int32_t>();
+		const int64_t* amount = columns[1].values<int64_t>();
+		const double* price = columns[2].values<double>();
+		const int64_t* at = columns[3].values<int64_t>();
+		for (std::size_t i = 0; i < n; ++i) {
+			t.qty += qty[i];
+		}
+		for (std::size_t i = 0; i < n; ++i) {
+			t.amount += amount[i];
+		}
+		for (std::size_t i = 0; i < n; ++i) {
+			t.price += price[i];
+		}
+		for (std::size_t i = 0; i < n; ++i) {
+			t.last = at[i] > t.last ? at[i] : t.last;
+		}
+		return t;
+	}
+
+	void report(const char* mode, int rows, double convert_ms, double total_ms, double check) {
+		std::printf("%16s %10d %12.1f %12.1f %10.1f %22.0f\n", mode, rows, convert_ms, total_ms, total_ms * 1e6 / rows, check);
+	}
+
+	void run_columns(const char* mode, const pg_result& res) {
+		auto t0 = std::chrono::steady_clock::now();
+		pg_columns columns(res);
+		double convert_ms = ms_since(t0);
+		totals t = aggregate(columns);
+		report(mode, res.rows_count(), convert_ms, ms_since(t0), t.check());
+	}
+
+}
+
+int main(int argc, char** argv) {
+
+	int rows = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+	pg_result text = make_result(rows, pg_format::text);
+	pg_result binary = make_result(rows, pg_format::binary);
+
+	std::printf("rows=%d cols=%d\n", rows, n_cols);
+	std::printf("%16s %10s %12s %12s %10s %22s\n", "mode", "rows", "convert ms", "total ms", "ns/row", "checksum");
+
+	auto t0 = std::chrono::steady_clock::now();
+	totals t = by_hand(text);
+	report("text by hand", rows, 0, ms_since(t0), t.check());
+
+	t0 = std::chrono::steady_clock::now();
+	t = with_get(text);
+	report("text get", rows, 0, ms_since(t0), t.check());
+
+	run_columns("text columns", text);
+
+	t0 = std::chrono::steady_clock::now();
+	t = with_get(binary);
+	report("binary get", rows, 0, ms_since(t0), t.check());
+
+	run_columns("binary columns", binary);
+
+	// the aggregation alone, over columns already converted
+	pg_columns columns(binary);
+	t0 = std::chrono::steady_clock::now();
+	t = aggregate(columns);
+	report("aggregate only", rows, 0, ms_since(t0), t.check());
+	return 0;
+}
@@ -0,0 +1,84 @@
+// Fan-out: a request handler issues n queries and waits for all of them,
+// on each future in turn against draining a completion queue in batches.
+// usage: bench_completion_queue [connections] [fan-out] [rounds]
+#include <sys/resource.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+namespace {
+
+	long context_switches() {
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_nvcsw + usage.ru_nivcsw;
+	}
+
+}
+
+int main(int argc, char** argv) {
+
+	int n_connections = argc > 1 ? std::atoi(argv[1]) : 4;
+	int fan_out = argc > 2 ? std::atoi(argv[2]) : 32;
+	int rounds = argc > 3 ? std::atoi(argv[3]) : 5000;
+
+	mock_pg_server server;
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	async_pg pg(server.connection_params());
+	pg_pool_options options;
+	options.n_connections = n_connections;
+	options.ready_connections = n_connections;
+	pg.start(options).get();
+
+	std::printf("connections=%d fan-out=%d rounds=%d\n", n_connections, fan_out, rounds);
+	std::printf("%10s %12s %12s %14s\n", "wait", "us/round", "csw/round", "batches/round");
+
+	{
+		long switches = context_switches();
+		auto t0 = std::chrono::steady_clock::now();
+		std::vector<std::future<std::list<pg_result>>> futures;
+		for (int r = 0; r < rounds; ++r) {
+			for (int i = 0; i < fan_out; ++i) {
+				futures.push_back(pg.execute("select 1"));
+			}
+			for (auto& f : futures) {
+				f.get();
+			}
+			futures.clear();
+		}
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+		std::printf("%10s %12.2f %12.2f %14d\n", "futures", us / rounds, (double)(context_switches() - switches) / rounds, fan_out);
+	}
+
+	{
+		pg_completion_queue queue;
+		std::vector<pg_completion_queue::event> events;
+		long batches = 0;
+		long switches = context_switches();
+		auto t0 = std::chrono::steady_clock::now();
+		for (int r = 0; r < rounds; ++r) {
+			for (int i = 0; i < fan_out; ++i) {
+				pg.execute("select 1", {}, queue, reinterpret_cast<void*>((intptr_t)i));
+			}
+			std::size_t left = fan_out;
+			while (left) {
+				left -= queue.next_batch(events, left, std::chrono::milliseconds(1000));
+				++batches;
+			}
+			events.clear();
+		}
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+		std::printf("%10s %12.2f %12.2f %14.2f\n", "queue", us / rounds, (double)(context_switches() - switches) / rounds, (double)batches / rounds);
+	}
+
+	pg.stop();
+	server.stop();
+	return 0;
+}
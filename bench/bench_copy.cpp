@@ -0,0 +1,96 @@
+// Ingest of device events: one INSERT per round trip against COPY FROM STDIN,
+// in text format and in binary format built with pg_copy_encoder.
+// usage: bench_copy [rows] [insert rows] [rtt_us]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+namespace {
+
+	double seconds_since(std::chrono::steady_clock::time_point t0) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	}
+
+	void report(const char* mode, long rows, double s) {
+		std::printf("%10s %10ld %14.0f\n", mode, rows, rows / s);
+	}
+
+}
+
+int main(int argc, char** argv) {
+
+	int rows = argc > 1 ? std::atoi(argv[1]) : 1000000;
+	int insert_rows = argc > 2 ? std::atoi(argv[2]) : 20000;
+
+	mock_pg_server::options server_options;
+	server_options.rtt_us = argc > 3 ? std::atoi(argv[3]) : 0;
+	mock_pg_server server(server_options);
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	pg_pool_options options;
+	options.n_connections = 1;
+	async_pg pg(server.connection_params());
+	pg.start(options).get();
+
+	std::string payload = "{\"temperature\":21.5,\"battery\":87}";
+	auto now = std::chrono::system_clock::now();
+
+	std::printf("rows=%d insert rows=%d rtt_us=%d\n", rows, insert_rows, server_options.rtt_us);
+	std::printf("%10s %10s %14s\n", "mode", "rows", "rows/s");
+
+	{
+		auto st = pg.prepare("insert_event", "INSERT INTO events (device, at, payload) VALUES ($1, $2, $3)");
+		auto t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < insert_rows; ++i) {
+			pg.execute_prepared(st, { pg_param::int32(i % 1000), pg_param::text("2024-01-01 00:00:00"), pg_param::text(payload) }).get();
+		}
+		report("insert", insert_rows, seconds_since(t0));
+	}
+
+	{
+		auto t0 = std::chrono::steady_clock::now();
+		auto writer = pg.copy_in("COPY events (device, at, payload) FROM STDIN");
+		std::string chunk;
+		for (int i = 0; i < rows; ++i) {
+			chunk += std::to_string(i % 1000);
+			chunk += "\t2024-01-01 00:00:00\t";
+			chunk += payload;
+			chunk += '\n';
+			if (chunk.size() >= 64 * 1024) {
+				writer->write(chunk);
+				chunk.clear();
+			}
+		}
+		writer->write(chunk);
+		auto results = writer->finish().get();
+		report("copy text", results.front().rows_affected(), seconds_since(t0));
+	}
+
+	{
+		auto t0 = std::chrono::steady_clock::now();
+		auto writer = pg.copy_in("COPY events (device, at, payload) FROM STDIN (FORMAT binary)");
+		pg_copy_encoder enc;
+		for (int i = 0; i < rows; ++i) {
+			enc.row(3).add((int32_t)(i % 1000)).add(now).add(payload);
+			if (enc.size() >= 64 * 1024) {
+				writer->write(enc.take());
+			}
+		}
+		writer->write(enc.end().take());
+		auto results = writer->finish().get();
+		report("copy bin", results.front().rows_affected(), seconds_since(t0));
+	}
+
+	pg_stats stats = pg.stats();
+	std::printf("copy_bytes=%llu\n", (unsigned long long)stats.copy_bytes);
+
+	pg.stop();
+	server.stop();
+	return 0;
+}
@@ -0,0 +1,116 @@
+// Export of a large table: SELECT read whole with execute against COPY TO STDOUT into a sink,
+// counted on the reactor thread, handed to a consumer thread through a pg_copy_buffer,
+// and written to a file. Peak memory is measured per run, the runs with the least memory go first.
+// usage: bench_copy_out [rows]
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+namespace {
+
+	// counts rows and bytes on the reactor thread
+	class counting_sink : public pg_copy_sink {
+	public:
+		bool write(const char* data, std::size_t size) override {
+			++rows;
+			bytes += size;
+			return true;
+		}
+		long rows = 0;
+		long bytes = 0;
+	};
+
+	long peak_kb() {
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+	}
+
+	double ms_since(std::chrono::steady_clock::time_point t0) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	}
+
+	void report(const char* mode, long rows, double ms, long peak_before) {
+		std::printf("%10s %10ld %12.1f %14.0f %12ld\n", mode, rows, ms, rows / ms * 1000, peak_kb() - peak_before);
+	}
+
+}
+
+int main(int argc, char** argv) {
+
+	int rows = argc > 1 ? std::atoi(argv[1]) : 2000000;
+
+	mock_pg_server::options server_options;
+	server_options.rows = rows;
+	mock_pg_server server(server_options);
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	pg_pool_options options;
+	options.n_connections = 1;
+	async_pg pg(server.connection_params());
+	pg.start(options).get();
+
+	std::printf("rows=%d\n", rows);
+	std::printf("%10s %10s %12s %14s %12s\n", "mode", "rows", "ms", "rows/s", "peak +KB");
+
+	{
+		long peak = peak_kb();
+		auto t0 = std::chrono::steady_clock::now();
+		counting_sink sink;
+		pg.copy_out("COPY (SELECT n FROM big) TO STDOUT", sink).get();
+		report("sink", sink.rows, ms_since(t0), peak);
+	}
+
+	{
+		long peak = peak_kb();
+		auto t0 = std::chrono::steady_clock::now();
+		pg_copy_buffer buffer(256 * 1024);
+		auto done = pg.copy_out("COPY (SELECT n FROM big) TO STDOUT", buffer);
+		long n = 0;
+		std::string data;
+		while (buffer.read(data)) {
+			for (char c : data) {
+				n += c == '\n';
+			}
+			data.clear();
+		}
+		done.get();
+		report("buffer", n, ms_since(t0), peak);
+	}
+
+	{
+		char path[] = "/tmp/bench_copy_out_XXXXXX";
+		int fd = mkstemp(path);
+		unlink(path);
+		long peak = peak_kb();
+		auto t0 = std::chrono::steady_clock::now();
+		pg_copy_fd_sink sink(fd);
+		auto results = pg.copy_out("COPY (SELECT n FROM big) TO STDOUT", sink).get();
+		report("file", results.front().rows_affected(), ms_since(t0), peak);
+		close(fd);
+	}
+
+	{
+		long peak = peak_kb();
+		auto t0 = std::chrono::steady_clock::now();
+		auto results = pg.execute("SELECT n FROM big").get();
+		long n = 0;
+		for (int i = 0; i < results.front().rows_count(); ++i) {
+			n += std::atoi(results.front().get_value(i, 0)) > 0;
+		}
+		report("execute", n, ms_since(t0), peak);
+	}
+
+	pg.stop();
+	server.stop();
+	return 0;
+}
@@ -0,0 +1,108 @@
+// Round trip overhead of co_await pg.query against execute().get(), sequential and with concurrent callers:
+// threads blocked on futures against coroutines resumed on the reactor thread.
+// usage: bench_coroutine [connections] [concurrency] [queries]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <thread>
+#include <vector>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+
+namespace {
+
+	// fire-and-forget coroutine, runs until its first suspension when called
+	struct task {
+		struct promise_type {
+			task get_return_object() { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+
+	task worker(async_pg& pg, int queries, std::atomic<int>& running, std::promise<void>& done) {
+		for (int i = 0; i < queries; ++i) {
+			co_await pg.query("select 1");
+		}
+		if (running.fetch_sub(1) == 1) {
+			done.set_value();
+		}
+	}
+
+	double run_coroutines(async_pg& pg, int concurrency, int queries) {
+		std::atomic<int> running(concurrency);
+		std::promise<void> done;
+		auto t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < concurrency; ++i) {
+			worker(pg, queries / concurrency, running, done);
+		}
+		done.get_future().get();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	}
+
+	double run_futures(async_pg& pg, int concurrency, int queries) {
+		auto t0 = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (int i = 0; i < concurrency; ++i) {
+			threads.emplace_back([&pg, n = queries / concurrency]() {
+				for (int q = 0; q < n; ++q) {
+					pg.execute("select 1").get();
+				}
+			});
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	}
+
+}
+
+int main(int argc, char** argv) {
+
+	int n_connections = argc > 1 ? std::atoi(argv[1]) : 4;
+	int concurrency = argc > 2 ? std::atoi(argv[2]) : 64;
+	int queries = argc > 3 ? std::atoi(argv[3]) : 100000;
+
+	mock_pg_server server;
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	async_pg pg(server.connection_params());
+	pg_pool_options options;
+	options.n_connections = n_connections;
+	options.ready_connections = n_connections;
+	pg.start(options).get();
+
+	std::printf("connections=%d queries=%d\n", n_connections, queries);
+	std::printf("%12s %12s %12s %12s\n", "callers", "api", "qps", "us/query");
+	for (int callers : { 1, concurrency }) {
+		double futures = run_futures(pg, callers, queries);
+		double coroutines = run_coroutines(pg, callers, queries);
+		int n = queries / callers * callers;
+		std::printf("%12d %12s %12.0f %12.2f\n", callers, "future", n / futures, futures * 1e6 / n);
+		std::printf("%12d %12s %12.0f %12.2f\n", callers, "co_await", n / coroutines, coroutines * 1e6 / n);
+	}
+
+	pg.stop();
+	server.stop();
+	return 0;
+}
+
+#else
+
+int main() {
+	std::fprintf(stderr, "bench_coroutine needs C++20 coroutines\n");
+	return 1;
+}
+
+#endif
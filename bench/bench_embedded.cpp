@@ -0,0 +1,167 @@
+// An application event loop issuing queries: the threaded pool handing completions over to the loop
+// through an executor and an eventfd, against the embedded pool driven by the loop itself.
+// Each completion issues the next query, with a fixed number of queries outstanding.
+// usage: bench_embedded [connections] [outstanding] [queries]
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+namespace {
+
+	// completions queued for the application loop, which is woken up through an eventfd
+	class loop_executor : public pg_executor {
+	public:
+		loop_executor() : _fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+		~loop_executor() { close(_fd); }
+
+		int fd() const { return _fd; }
+
+		void post(pg_completion&& completion) override {
+			bool first;
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				first = _completions.empty();
+				_completions.push_back(std::move(completion));
+			}
+			if (first) {
+				uint64_t one = 1;
+				write(_fd, &one, sizeof(one));
+			}
+		}
+
+		void run() {
+			uint64_t counter;
+			read(_fd, &counter, sizeof(counter));
+			std::deque<pg_completion> completions;
+			{
+				std::lock_guard<std::mutex> lock(_mtx);
+				completions.swap(_completions);
+			}
+			for (auto& c : completions) {
+				c.run();
+			}
+		}
+
+	private:
+		int _fd;
+		std::mutex _mtx;
+		std::deque<pg_completion> _completions;
+	};
+
+	struct client {
+		async_pg& pg;
+		pg_executor* executor;
+		int left;
+		int done = 0;
+
+		void issue() {
+			if (left == 0) {
+				return;
+			}
+			--left;
+			pg.execute("select 1", {}, [this](std::exception_ptr, std::list<pg_result>&&) {
+				++done;
+				issue();
+			}, executor);
+		}
+	};
+
+	long context_switches() {
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_nvcsw + usage.ru_nivcsw;
+	}
+
+	void report(const char* mode, int queries, std::chrono::steady_clock::time_point t0, long switches) {
+		double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		std::printf("%10s %12.0f %12.2f %12.2f\n", mode, queries / s, s * 1e6 / queries, (double)(context_switches() - switches) / queries);
+	}
+
+}
+
+int main(int argc, char** argv) {
+
+	int n_connections = argc > 1 ? std::atoi(argv[1]) : 4;
+	int outstanding = argc > 2 ? std::atoi(argv[2]) : 16;
+	int queries = argc > 3 ? std::atoi(argv[3]) : 100000;
+
+	mock_pg_server server;
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	pg_pool_options options;
+	options.n_connections = n_connections;
+	options.ready_connections = n_connections;
+
+	std::printf("connections=%d outstanding=%d queries=%d\n", n_connections, outstanding, queries);
+	std::printf("%10s %12s %12s %12s\n", "mode", "qps", "us/query", "csw/query");
+
+	{
+		async_pg pg(server.connection_params());
+		pg.start(options).get();
+		loop_executor executor;
+		int ep = epoll_create1(0);
+		epoll_event e{};
+		e.events = EPOLLIN;
+		epoll_ctl(ep, EPOLL_CTL_ADD, executor.fd(), &e);
+
+		client c{ pg, &executor, queries };
+		long switches = context_switches();
+		auto t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < outstanding; ++i) {
+			c.issue();
+		}
+		while (c.done < queries) {
+			epoll_event ev;
+			if (epoll_wait(ep, &ev, 1, -1) > 0) {
+				executor.run();
+			}
+		}
+		report("threaded", queries, t0, switches);
+		close(ep);
+		pg.stop();
+	}
+
+	{
+		async_pg pg(server.connection_params());
+		options.embedded = true;
+		auto ready = pg.start(options);
+		int ep = epoll_create1(0);
+		epoll_event e{};
+		e.events = EPOLLIN;
+		epoll_ctl(ep, EPOLL_CTL_ADD, pg.fd(), &e);
+		while (ready.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			epoll_event ev;
+			epoll_wait(ep, &ev, 1, pg.timeout());
+			pg.run_once();
+		}
+
+		client c{ pg, nullptr, queries };
+		long switches = context_switches();
+		auto t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < outstanding; ++i) {
+			c.issue();
+		}
+		while (c.done < queries) {
+			epoll_event ev;
+			epoll_wait(ep, &ev, 1, pg.timeout());
+			pg.run_once();
+		}
+		report("embedded", queries, t0, switches);
+		close(ep);
+		pg.stop();
+	}
+
+	server.stop();
+	return 0;
+}
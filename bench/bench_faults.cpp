@@ -0,0 +1,578 @@
+// Checks of the fault handling paths of the pool against the mock server, each with its own pool.
+// A check prints ok, or the outcomes it did not expect, and the program exits with 1 if any of them failed.
+// usage: bench_faults [check...]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+namespace {
+
+	using results = std::future<std::list<pg_result>>;
+
+	int failed_expectations = 0;
+
+	void expect(bool ok, const std::string& what) {
+		if (!ok) {
+			std::printf("\texpected %s\n", what.c_str());
+			++failed_expectations;
+		}
+	}
+
+	// "ok", the error of the query or of its results, or "pending" if it did not complete within ms
+	std::string outcome(results& f, int ms = 2000) {
+		if (f.wait_for(std::chrono::milliseconds(ms)) != std::future_status::ready) {
+			return "pending";
+		}
+		try {
+			for (auto& r : f.get()) {
+				r.check();
+			}
+			return "ok";
+		}
+		catch (const std::exception& e) {
+			std::string error = e.what();
+			while (error.size() && error.back() == '\n') {
+				error.pop_back();
+			}
+			return error;
+		}
+	}
+
+	void expect_outcome(results& f, const std::string& expected, const char* query, int ms = 2000) {
+		std::string o = outcome(f, ms);
+		// server errors come with their severity and position, the message is enough
+		expect(o.find(expected) != std::string::npos, std::string(query) + " -> " + expected + ", got " + o);
+	}
+
+	double ms_since(std::chrono::steady_clock::time_point t0) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	}
+
+	// a query in flight past its deadline is cancelled on the server, the connection is free right after
+	void check_timeout_cancel() {
+		mock_pg_server server;
+		server.start();
+		async_pg pg(server.connection_params());
+		pg.start(1).get();
+
+		auto t0 = std::chrono::steady_clock::now();
+		results slow = pg.execute("select pg_sleep(5)", {}, std::chrono::milliseconds(100));
+		expect_outcome(slow, "query timeout", "select pg_sleep(5) with a 100 ms timeout");
+		results next = pg.execute("select 1");
+		expect_outcome(next, "ok", "select 1 after the timeout");
+		expect(ms_since(t0) < 1000, "the cancelled sleep to free the connection within 1 s");
+		expect(pg.stats().queries_cancelled == 1, "1 cancel request");
+		pg.stop();
+	}
+
+	// a query that expires in the queue is never sent
+	void check_timeout_queued() {
+		mock_pg_server server;
+		server.start();
+		async_pg pg(server.connection_params());
+		pg.start(1).get();
+
+		results busy = pg.execute("select pg_sleep(0.3)");
+		results queued = pg.execute("select 1", {}, std::chrono::milliseconds(50));
+		expect_outcome(queued, "query timeout", "a queued select 1 with a 50 ms timeout");
+		expect_outcome(busy, "ok", "select pg_sleep(0.3)");
+		expect(pg.stats().queries_cancelled == 0, "no cancel request");
+		pg.stop();
+	}
+
+	// A pipelined query that expires behind a running one is not cancelled once that completes:
+	// the server may be running the query behind it already.
+	void check_timeout_pipelined() {
+		mock_pg_server server;
+		server.start();
+		pg_pool_options options;
+		options.pipeline_depth = 4;
+		async_pg pg(server.connection_params());
+		pg.start(options).get();
+
+		results first = pg.execute("select pg_sleep(0.3)");
+		results expired = pg.execute("select 1", {}, std::chrono::milliseconds(100));
+		results last = pg.execute("select pg_sleep(0.3)");
+		expect_outcome(first, "ok", "select pg_sleep(0.3)");
+		expect_outcome(expired, "query timeout", "select 1 with a 100 ms timeout pipelined behind it");
+		expect_outcome(last, "ok", "select pg_sleep(0.3) pipelined behind the expired query");
+		expect(pg.stats().queries_cancelled == 0, "no cancel request");
+		pg.stop();
+	}
+
+	// a bounded queue fails queries beyond its capacity, try_execute returns nothing
+	void check_queue_full() {
+		mock_pg_server server;
+		server.start();
+		pg_pool_options options;
+		options.queue_capacity = 2;
+		options.queue_full = pg_pool_options::queue_full_t::fail;
+		async_pg pg(server.connection_params());
+		pg.start(options).get();
+
+		results running = pg.execute("select pg_sleep(0.2)");
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		std::vector<results> queued;
+		queued.push_back(pg.execute("select 1"));
+		queued.push_back(pg.execute("select 1"));
+		results rejected = pg.execute("select 1");
+		expect_outcome(rejected, "queue full", "a third queued select 1", 0);
+		expect(!pg.try_execute("select 1"), "try_execute to return nothing on a full queue");
+		expect_outcome(running, "ok", "select pg_sleep(0.2)");
+		for (auto& q : queued) {
+			expect_outcome(q, "ok", "a queued select 1");
+		}
+		auto later = pg.try_execute("select 1");
+		expect(later.has_value(), "try_execute to take a query once the queue drained");
+		if (later) {
+			expect_outcome(*later, "ok", "select 1 through try_execute");
+		}
+		expect(pg.stats().queries_rejected == 2, "2 queries rejected");
+		pg.stop();
+	}
+
+	// queries submitted after stop fail at once, whether the queue blocks or fails when full
+	void check_after_stop() {
+		mock_pg_server server;
+		server.start();
+		for (auto mode : { pg_pool_options::queue_full_t::block, pg_pool_options::queue_full_t::fail }) {
+			pg_pool_options options;
+			options.queue_full = mode;
+			async_pg pg(server.connection_params());
+			pg.start(options).get();
+			pg.stop();
+			results late = pg.execute("select 1");
+			expect_outcome(late, "stopping service", "select 1 after stop", 200);
+			expect(!pg.try_execute("select 1"), "try_execute to return nothing after stop");
+		}
+	}
+
+	// Queries waiting longer than the shedding target for a whole interval are dropped with "overloaded",
+	// and the pool takes queries again once the queue drained.
+	void check_shed() {
+		mock_pg_server server;
+		server.start();
+		pg_pool_options options;
+		options.shed_target_ms = 20;
+		options.shed_interval_ms = 50;
+		async_pg pg(server.connection_params());
+		pg.start(options).get();
+
+		// a second of work for one connection
+		std::vector<results> queries;
+		for (int i = 0; i < 100; ++i) {
+			queries.push_back(pg.execute("select pg_sleep(0.01)"));
+		}
+		int ok = 0;
+		int shed = 0;
+		for (auto& q : queries) {
+			std::string o = outcome(q, 5000);
+			ok += o == "ok";
+			shed += o == "overloaded";
+		}
+		expect(ok + shed == 100, "every query to complete or be shed, got " + std::to_string(ok) + " and " + std::to_string(shed));
+		expect(ok > 0 && shed > 0, "some queries shed and some run, got " + std::to_string(shed) + " shed");
+		uint64_t counted = pg.stats().queries_shed;
+		expect(counted == (uint64_t)shed, std::to_string(shed) + " queries counted as shed, got " + std::to_string(counted));
+		// the reactor stops shedding right after it took the last query
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		results after = pg.execute("select 1");
+		expect_outcome(after, "ok", "select 1 once the queue drained");
+		pg.stop();
+	}
+
+	// waits up to ms for done to hold
+	bool eventually(std::function<bool()> done, int ms) {
+		auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+		while (!done()) {
+			if (std::chrono::steady_clock::now() >= until) {
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		return true;
+	}
+
+	// the pool grows up to max_connections while queries wait, and shrinks back once they are idle
+	void check_resize() {
+		mock_pg_server server;
+		server.start();
+		pg_pool_options options;
+		options.n_connections = 1;
+		options.max_connections = 3;
+		options.idle_timeout_ms = 200;
+		async_pg pg(server.connection_params());
+		pg.start(options).get();
+
+		auto t0 = std::chrono::steady_clock::now();
+		std::vector<results> queries;
+		for (int i = 0; i < 6; ++i) {
+			queries.push_back(pg.execute("select pg_sleep(0.2)"));
+		}
+		// sampled while the queries wait rather than between their results, a loaded machine connects slowly
+		expect(eventually([&pg] { return pg.stats().connections == 3; }, 1000), "the pool to grow to 3 connections");
+		for (auto& q : queries) {
+			expect_outcome(q, "ok", "select pg_sleep(0.2)");
+		}
+		// 1.2 s on one connection
+		expect(ms_since(t0) < 1000, "6 queries of 200 ms within 1 s on a grown pool");
+		expect(eventually([&pg] { return pg.stats().connections == 1; }, 2000), "the pool to shrink back to 1 connection");
+		pg_stats stats = pg.stats();
+		expect(stats.connections_grown == 2 && stats.connections_retired == 2, "2 connections grown and retired, got "
+			+ std::to_string(stats.connections_grown) + " and " + std::to_string(stats.connections_retired));
+		pg.stop();
+	}
+
+	// idle connections are probed every keepalive_ms and keep serving queries
+	void check_keepalive() {
+		mock_pg_server server;
+		server.start();
+		pg_pool_options options;
+		options.keepalive_ms = 100;
+		async_pg pg(server.connection_params());
+		pg.start(options).get();
+
+		expect(eventually([&pg] { return pg.stats().keepalive_probes >= 3; }, 1000), "3 keepalive probes within 1 s");
+		results query = pg.execute("select 1");
+		expect_outcome(query, "ok", "select 1 between probes");
+		expect(server.accepted() == 1, "the probed connection to stay open");
+		pg.stop();
+	}
+
+	// connections past max_lifetime_ms are replaced by new ones, and the pool keeps serving queries meanwhile
+	void check_recycle() {
+		mock_pg_server server;
+		server.start();
+		pg_pool_options options;
+		options.n_connections = 2;
+		options.ready_connections = 2;
+		options.max_lifetime_ms = 300;
+		async_pg pg(server.connection_params());
+		pg.start(options).get();
+
+		// lifetimes are checked every second, one connection is replaced at a time
+		auto t0 = std::chrono::steady_clock::now();
+		while (ms_since(t0) < 2500) {
+			results query = pg.execute("select 1");
+			expect_outcome(query, "ok", "select 1 while connections are recycled");
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+		pg_stats stats = pg.stats();
+		expect(stats.connections_recycled >= 2, "2 connections recycled within 2.5 s, got " + std::to_string(stats.connections_recycled));
+		expect(server.accepted() == 2 + (int)stats.connections_recycled, "a new connection for every recycled one");
+		expect(stats.connections == 2, "2 connections open");
+		pg.stop();
+	}
+
+	// A completion queue destroyed on the thread holding its wakeup, as by a callback on the reactor thread,
+	// after a worker took the event on a timeout. Run on a thread of its own, a destructor that hangs is reported.
+	void check_completion_queue_destroy() {
+		std::promise<void> destroyed;
+		std::future<void> done = destroyed.get_future();
+		std::thread([&destroyed] {
+			pg_completion_queue::hold_wakeups(true);
+			auto queue = new pg_completion_queue();
+			std::thread worker([queue] {
+				std::vector<pg_completion_queue::event> events;
+				queue->next_batch(events, 16, std::chrono::milliseconds(100));
+			});
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			queue->push(nullptr, nullptr, {});
+			worker.join();
+			delete queue;
+			pg_completion_queue::hold_wakeups(false);
+			destroyed.set_value();
+		}).detach();
+		expect(done.wait_for(std::chrono::seconds(1)) == std::future_status::ready, "the queue to be destroyed within 1 s");
+	}
+
+	// a pool restarted with fewer connections than it had reactors runs every query
+	void check_restart_fewer() {
+		mock_pg_server server;
+		server.start();
+		async_pg pg(server.connection_params());
+		for (int n_connections : { 4, 1, 3 }) {
+			pg_pool_options options;
+			options.n_connections = n_connections;
+			options.ready_connections = n_connections;
+			options.n_reactors = 4;
+			pg.start(options).get();
+			std::vector<results> queries;
+			for (int i = 0; i < 8; ++i) {
+				queries.push_back(pg.execute("select 1"));
+			}
+			for (auto& q : queries) {
+				expect_outcome(q, "ok", ("select 1 on " + std::to_string(n_connections) + " connection(s)").c_str());
+			}
+			expect(pg.stats().connections == (uint64_t)n_connections, std::to_string(n_connections) + " connection(s) open");
+			pg.stop();
+		}
+	}
+
+	// Queries submitted while the pool is restarted with another number of reactors run or fail
+	// with "stopping service", none is abandoned with the reactors it was queued on.
+	void check_restart_submitting() {
+		mock_pg_server server;
+		server.start();
+		async_pg pg(server.connection_params());
+		std::atomic<bool> submitting{ true };
+		std::atomic<int> submitted{ 0 };
+		std::atomic<int> completed{ 0 };
+		std::atomic<int> abandoned{ 0 };
+		std::thread producer([&] {
+			while (submitting.load()) {
+				if (submitted.load() - completed.load() >= 64) {
+					std::this_thread::yield();
+					continue;
+				}
+				++submitted;
+				pg.execute("select 1", {}, [&](std::exception_ptr error, std::list<pg_result>&&) {
+					if (error) {
+						try {
+							std::rethrow_exception(error);
+						}
+						catch (const std::exception& e) {
+							abandoned += std::strcmp(e.what(), "stopping service") != 0;
+						}
+					}
+					++completed;
+				});
+			}
+		});
+		for (int n_reactors : { 1, 3, 2, 1 }) {
+			pg_pool_options options;
+			options.n_connections = 3;
+			options.n_reactors = n_reactors;
+			pg.start(options).get();
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			pg.stop();
+		}
+		pg.start(1).get();
+		submitting = false;
+		producer.join();
+		expect(eventually([&] { return completed.load() == submitted.load(); }, 2000), "every query to complete, "
+			+ std::to_string(completed.load()) + " of " + std::to_string(submitted.load()) + " did");
+		expect(abandoned == 0, "no query failing with another error than stopping service, got " + std::to_string(abandoned.load()));
+		pg.stop();
+	}
+
+	// A pool whose host does not resolve keeps retrying in the background: queries wait and time out,
+	// the start future is not ready and fails once the pool is stopped.
+	void check_start_unresolved() {
+		mock_pg_server server;
+		server.start();
+		auto params = server.connection_params();
+		params.erase("hostaddr");
+		params["host"] = "nonexistent.invalid";
+		pg_pool_options options;
+		options.n_connections = 2;
+		options.n_reactors = 2;
+		async_pg pg(params);
+		std::shared_future<void> ready = pg.start(options);
+
+		results query = pg.execute("select 1", {}, std::chrono::milliseconds(200));
+		expect_outcome(query, "query timeout", "select 1 with a 200 ms timeout");
+		expect(ready.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout, "the start future not ready");
+		pg.stop();
+		std::string error = "ok";
+		try {
+			ready.get();
+		}
+		catch (const std::exception& e) {
+			error = e.what();
+		}
+		expect(error == "stopping service", "the start future to fail with stopping service, got " + error);
+	}
+
+	// Connections lost while the server refuses new ones reconnect with backoff, not in a loop,
+	// and the pool recovers once the server accepts them again.
+	void check_reconnect_backoff() {
+		mock_pg_server server;
+		server.start();
+		pg_pool_options options;
+		options.reconnect_min_ms = 100;
+		options.reconnect_max_ms = 400;
+		async_pg pg(server.connection_params());
+		pg.start(options).get();
+
+		server.refuse_connections(true);
+		int accepted = server.accepted();
+		server.drop_connections();
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		// an immediate attempt, then 50-100, 100-200, 200-400 and 200-400 ms apart
+		int attempts = server.accepted() - accepted;
+		expect(attempts >= 2 && attempts <= 10, "2 to 10 connection attempts in 1 s, got " + std::to_string(attempts));
+
+		server.refuse_connections(false);
+		results query = pg.execute("select 1");
+		expect_outcome(query, "ok", "select 1 once the server accepts connections again");
+		pg.stop();
+	}
+
+	// Queries in flight on a lost connection: the idempotent one is sent again once it reconnects,
+	// the other fails with pg_connection_error.
+	void check_replay() {
+		mock_pg_server server;
+		server.start();
+		pg_pool_options options;
+		options.pipeline_depth = 4;
+		async_pg pg(server.connection_params());
+		pg.start(options).get();
+
+		results idempotent = pg.execute("select pg_sleep(0.3)", {}, {}, true);
+		results other = pg.execute("select pg_sleep(0.3)");
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		server.drop_connections();
+		expect_outcome(idempotent, "ok", "an idempotent select pg_sleep(0.3) on a lost connection");
+		expect_outcome(other, "server closed the connection", "select pg_sleep(0.3) on a lost connection");
+		pg_stats stats = pg.stats();
+		expect(stats.queries_replayed == 1, "1 query replayed, got " + std::to_string(stats.queries_replayed));
+		expect(stats.queries_aborted == 1, "1 query aborted, got " + std::to_string(stats.queries_aborted));
+		pg.stop();
+	}
+
+	// a prepared query is not pipelined behind a paused stream holding its statement, it runs on another connection
+	void check_stream_holder() {
+		mock_pg_server::options server_options;
+		server_options.rows = 20000;
+		mock_pg_server server(server_options);
+		server.start();
+		pg_pool_options options;
+		options.n_connections = 2;
+		options.ready_connections = 2;
+		options.pipeline_depth = 4;
+		async_pg pg(server.connection_params());
+		pg.start(options).get();
+
+		// the statement is prepared on the connection the stream takes next, the last one idle
+		results prepared = pg.execute_prepared("s", "select 1");
+		expect_outcome(prepared, "ok", "execute_prepared(s)");
+		auto stream = pg.stream("select n from big", {}, 16);
+		expect(stream->next().has_value(), "a first row from the stream");
+		results behind = pg.execute_prepared("s", "select 1");
+		expect_outcome(behind, "ok", "execute_prepared(s) while the stream is not read", 1000);
+		stream->close();
+		pg.stop();
+	}
+
+	// A prepared query waits for a copy holding the only connection with its statement, and is not sent
+	// on that connection meanwhile: once the copy is over it runs there, with a second connection it runs
+	// there right away.
+	void check_copy_holder() {
+		mock_pg_server server;
+		server.start();
+		for (int n_connections = 1; n_connections <= 2; ++n_connections) {
+			pg_pool_options options;
+			options.n_connections = n_connections;
+			options.ready_connections = n_connections;
+			options.pipeline_depth = 4;
+			async_pg pg(server.connection_params());
+			pg.start(options).get();
+
+			// the statement is prepared on the connection the copy takes next, the last one idle
+			results prepared = pg.execute_prepared("s", "select 1");
+			expect_outcome(prepared, "ok", "execute_prepared(s)");
+			auto writer = pg.copy_in("COPY t FROM STDIN");
+			writer->write("1\n");
+			results behind = pg.execute_prepared("s", "select 1");
+			if (n_connections == 1) {
+				expect_outcome(behind, "pending", "execute_prepared(s) during the copy on the only connection", 200);
+				results copied = writer->finish();
+				expect_outcome(copied, "ok", "the copy");
+				expect_outcome(behind, "ok", "execute_prepared(s) after the copy");
+			}
+			else {
+				expect_outcome(behind, "ok", "execute_prepared(s) during the copy on the other connection", 1000);
+				results copied = writer->finish();
+				expect_outcome(copied, "ok", "the copy");
+			}
+			pg.stop();
+		}
+	}
+
+	// a copy whose writer is dropped unfinished is aborted and frees its connection, finish and abort end it once
+	void check_copy_abandoned() {
+		mock_pg_server server;
+		server.start();
+		async_pg pg(server.connection_params());
+		pg.start(1).get();
+
+		auto writer = pg.copy_in("COPY t FROM STDIN");
+		writer->write("1\n");
+		writer.reset();
+		results after = pg.execute("select 1");
+		expect_outcome(after, "ok", "select 1 after the writer was dropped", 1000);
+
+		writer = pg.copy_in("COPY t FROM STDIN");
+		results copied = writer->finish();
+		expect_outcome(copied, "ok", "the copy");
+		std::string again = "ok";
+		try {
+			writer->abort("late");
+		}
+		catch (const std::exception& e) {
+			again = e.what();
+		}
+		expect(again == "copy already finished or aborted", "abort after finish to throw, got " + again);
+		pg.stop();
+	}
+
+	struct check {
+		const char* name;
+		std::function<void()> run;
+	};
+
+	const check checks[] = {
+		{ "timeout_cancel", check_timeout_cancel },
+		{ "timeout_queued", check_timeout_queued },
+		{ "timeout_pipelined", check_timeout_pipelined },
+		{ "queue_full", check_queue_full },
+		{ "after_stop", check_after_stop },
+		{ "shed", check_shed },
+		{ "resize", check_resize },
+		{ "keepalive", check_keepalive },
+		{ "recycle", check_recycle },
+		{ "completion_queue_destroy", check_completion_queue_destroy },
+		{ "restart_fewer", check_restart_fewer },
+		{ "restart_submitting", check_restart_submitting },
+		{ "start_unresolved", check_start_unresolved },
+		{ "reconnect_backoff", check_reconnect_backoff },
+		{ "replay", check_replay },
+		{ "stream_holder", check_stream_holder },
+		{ "copy_holder", check_copy_holder },
+		{ "copy_abandoned", check_copy_abandoned },
+	};
+
+}
+
+int main(int argc, char** argv) {
+
+	// the pool logs to stdout too, lines stay in order
+	std::setvbuf(stdout, nullptr, _IOLBF, 0);
+
+	int failed = 0;
+	for (const check& c : checks) {
+		bool selected = argc == 1;
+		for (int i = 1; i < argc; ++i) {
+			selected = selected || std::strcmp(argv[i], c.name) == 0;
+		}
+		if (!selected) {
+			continue;
+		}
+		failed_expectations = 0;
+		std::printf("check %s\n", c.name);
+		c.run();
+		std::printf("check %s: %s\n", c.name, failed_expectations ? "FAILED" : "ok");
+		failed += failed_expectations > 0;
+	}
+	std::printf("%d check(s) failed\n", failed);
+	return failed ? 1 : 0;
+}
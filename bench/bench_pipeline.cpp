@@ -0,0 +1,66 @@
+// Queries per second on one connection by pipeline depth, at a simulated round trip time.
+// usage: bench_pipeline [rtt us] [threads] [seconds per run]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+int main(int argc, char** argv) {
+
+	mock_pg_server::options server_options;
+	server_options.rtt_us = argc > 1 ? std::atoi(argv[1]) : 1000;
+	int n_threads = argc > 2 ? std::atoi(argv[2]) : 64;
+	double seconds = argc > 3 ? std::atof(argv[3]) : 2.0;
+
+	mock_pg_server server(server_options);
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	std::printf("rtt=%dus threads=%d connections=1\n", server_options.rtt_us, n_threads);
+	std::printf("%6s %12s\n", "depth", "qps");
+
+	for (int depth : { 1, 4, 16, 64 }) {
+
+		pg_pool_options options;
+		options.n_connections = 1;
+		options.pipeline_depth = depth;
+
+		async_pg pg(server.connection_params());
+		pg.start(options);
+		pg.execute("select 1").get();
+
+		std::atomic<bool> running(true);
+		pg_stats before = pg.stats();
+		auto t0 = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < n_threads; ++t) {
+			threads.emplace_back([&pg, &running] {
+				while (running.load(std::memory_order_relaxed)) {
+					pg.execute("select $1::int4", { pg_param::int32(1) }).get();
+				}
+			});
+		}
+
+		std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+		running = false;
+		for (auto& t : threads) {
+			t.join();
+		}
+
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		pg_stats after = pg.stats();
+		pg.stop();
+
+		std::printf("%6d %12.0f\n", depth, (after.queries_completed - before.queries_completed) / elapsed);
+	}
+
+	server.stop();
+	return 0;
+}
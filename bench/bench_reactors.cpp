@@ -0,0 +1,70 @@
+// Throughput as a function of the number of reactor threads.
+// usage: bench_reactors [connections] [threads] [seconds per run] [max reactors]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+int main(int argc, char** argv) {
+
+	int n_connections = argc > 1 ? std::atoi(argv[1]) : 64;
+	int n_threads = argc > 2 ? std::atoi(argv[2]) : 256;
+	double seconds = argc > 3 ? std::atof(argv[3]) : 2.0;
+	int max_reactors = argc > 4 ? std::atoi(argv[4]) : (int)std::thread::hardware_concurrency();
+
+	mock_pg_server server;
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	std::printf("connections=%d threads=%d\n", n_connections, n_threads);
+	std::printf("%8s %12s %12s\n", "reactors", "qps", "stolen");
+
+	for (int n_reactors = 1; n_reactors <= max_reactors; n_reactors *= 2) {
+
+		pg_pool_options options;
+		options.n_connections = n_connections;
+		options.n_reactors = n_reactors;
+
+		async_pg pg(server.connection_params());
+		pg.start(options);
+		for (int i = 0; i < n_connections; ++i) {
+			pg.execute("select 1").get();
+		}
+
+		std::atomic<bool> running(true);
+		pg_stats before = pg.stats();
+		auto t0 = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < n_threads; ++t) {
+			threads.emplace_back([&pg, &running] {
+				while (running.load(std::memory_order_relaxed)) {
+					pg.execute("select 1").get();
+				}
+			});
+		}
+
+		std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+		running = false;
+		for (auto& t : threads) {
+			t.join();
+		}
+
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		pg_stats after = pg.stats();
+		pg.stop();
+
+		std::printf("%8d %12.0f %12llu\n", n_reactors,
+			(after.queries_completed - before.queries_completed) / elapsed,
+			(unsigned long long)(after.queries_stolen - before.queries_stolen));
+	}
+
+	server.stop();
+	return 0;
+}
@@ -0,0 +1,171 @@
+// Rows of a result read into structs: by hand with col_number and atoi per row, with pg_result::get
+// on columns looked up once, and with pg_rows. The results are built in memory with integer, bigint,
+// double, text and nullable timestamptz columns, in text and binary format.
+// usage: bench_row [rows]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+#include "async_pg/async_pg.hpp"
+
+namespace {
+
+	struct order {
+		int32_t id = 0;
+		int64_t customer = 0;
+		double amount = 0;
+		std::string_view status;
+		std::optional<std::chrono::system_clock::time_point> shipped;
+	};
+
+	const int n_cols = 5;
+	const Oid oids[n_cols] = { pg_int4_oid, pg_int8_oid, pg_float8_oid, pg_text_oid, pg_timestamptz_oid };
+	const char* names[n_cols] = { "id", "customer", "amount", "status", "shipped" };
+
+}
+
+PG_ROW(order, PG_FIELD(order, id), PG_FIELD(order, customer), PG_FIELD(order, amount), PG_FIELD(order, status), PG_FIELD(order, shipped));
+
+namespace {
+
+	double ms_since(std::chrono::steady_clock::time_point t0) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	}
+
+	void put(char* p, uint64_t value, int size) {
+		for (int i = size - 1; i >= 0; --i) {
+			p[i] = (char)value;
+			value >>= 8;
+		}
+	}
+
+	pg_result make_result(int rows, pg_format format) {
+		PGresult* res = PQmakeEmptyPGresult(nullptr, PGRES_TUPLES_OK);
+		PGresAttDesc attrs[n_cols];
+		for (int c = 0; c < n_cols; ++c) {
+			attrs[c] = PGresAttDesc{ (char*)names[c], 0, 0, (int)format, oids[c], -1, -1 };
+		}
+		PQsetResultAttrs(res, n_cols, attrs);
+
+		for (int r = 0; r < rows; ++r) {
+			int64_t us = 768000000000000LL + r * 1000001LL;
+			double d = r * 0.25;
+			const char* status = r % 3 ? "shipped" : "open";
+			PQsetvalue(res, r, 3, (char*)status, (int)std::strlen(status));
+			if (format == pg_format::binary) {
+				char b[8];
+				put(b, (uint32_t)r, 4);
+				PQsetvalue(res, r, 0, b, 4);
+				put(b, (uint64_t)r * 1000003, 8);
+				PQsetvalue(res, r, 1, b, 8);
+				uint64_t bits;
+				std::memcpy(&bits, &d, 8);
+				put(b, bits, 8);
+				PQsetvalue(res, r, 2, b, 8);
+				put(b, (uint64_t)us, 8);
+				PQsetvalue(res, r, 4, r % 3 ? b : nullptr, r % 3 ? 8 : -1);
+			}
+			else {
+				char v[64];
+				int n = std::snprintf(v, sizeof(v), "%d", r);
+				PQsetvalue(res, r, 0, v, n);
+				n = std::snprintf(v, sizeof(v), "%lld", (long long)r * 1000003);
+				PQsetvalue(res, r, 1, v, n);
+				n = std::snprintf(v, sizeof(v), "%.17g", d);
+				PQsetvalue(res, r, 2, v, n);
+				time_t s = (time_t)(us / 1000000 + 946684800);
+				tm t;
+				gmtime_r(&s, &t);
+				n = std::snprintf(v, sizeof(v), "%04d-%02d-%02d %02d:%02d:%02d.%06d+00", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
+					t.tm_hour, t.tm_min, t.tm_sec, (int)(us % 1000000));
+				PQsetvalue(res, r, 4, r % 3 ? v : nullptr, r % 3 ? n : -1);
+			}
+		}
+		return pg_result(res);
+	}
+
+	// the way callers index results today; text only
+	std::vector<order> by_hand(const pg_result& res) {
+		std::vector<order> orders;
+		for (int r = 0; r < res.rows_count(); ++r) {
+			order o;
+			o.id = std::atoi(res.get_value(r, res.col_number("id")));
+			o.customer = std::atoll(res.get_value(r, res.col_number("customer")));
+			o.amount = std::strtod(res.get_value(r, res.col_number("amount")), nullptr);
+			int status = res.col_number("status");
+			o.status = std::string_view(res.get_value(r, status), res.get_length(r, status));
+			int shipped = res.col_number("shipped");
+			if (!res.is_null(r, shipped)) {
+				tm t{};
+				int us = 0;
+				std::sscanf(res.get_value(r, shipped), "%d-%d-%d %d:%d:%d.%d", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec, &us);
+				t.tm_year -= 1900;
+				t.tm_mon -= 1;
+				o.shipped = std::chrono::system_clock::from_time_t(timegm(&t)) + std::chrono::microseconds(us);
+			}
+			orders.push_back(o);
+		}
+		return orders;
+	}
+
+	std::vector<order> with_get(const pg_result& res) {
+		std::vector<order> orders;
+		int id = res.col_number("id");
+		int customer = res.col_number("customer");
+		int amount = res.col_number("amount");
+		int status = res.col_number("status");
+		int shipped = res.col_number("shipped");
+		for (int r = 0; r < res.rows_count(); ++r) {
+			order o;
+			o.id = res.get<int32_t>(r, id);
+			o.customer = res.get<int64_t>(r, customer);
+			o.amount = res.get<double>(r, amount);
+			o.status = res.get<std::string_view>(r, status);
+			if (!res.is_null(r, shipped)) {
+				o.shipped = res.get<std::chrono::system_clock::time_point>(r, shipped);
+			}
+			orders.push_back(o);
+		}
+		return orders;
+	}
+
+	double checksum(const std::vector<order>& orders) {
+		double sum = 0;
+		for (auto& o : orders) {
+			sum += o.id + o.customer + o.amount + o.status.size();
+			if (o.shipped) {
+				sum += std::chrono::duration_cast<std::chrono::seconds>(o.shipped->time_since_epoch()).count();
+			}
+		}
+		return sum;
+	}
+
+	template <typename F>
+	void run(const char* mode, const pg_result& res, F read) {
+		auto t0 = std::chrono::steady_clock::now();
+		std::vector<order> orders = read(res);
+		double ms = ms_since(t0);
+		std::printf("%16s %10zu %10.1f %10.1f %18.0f\n", mode, orders.size(), ms, ms * 1e6 / orders.size(), checksum(orders));
+	}
+
+}
+
+int main(int argc, char** argv) {
+
+	int rows = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+	pg_result text = make_result(rows, pg_format::text);
+	pg_result binary = make_result(rows, pg_format::binary);
+
+	std::printf("rows=%d cols=%d\n", rows, n_cols);
+	std::printf("%16s %10s %10s %10s %18s\n", "mode", "rows", "ms", "ns/row", "checksum");
+	run("text by hand", text, by_hand);
+	run("text get", text, with_get);
+	run("text pg_rows", text, [](const pg_result& res) { return pg_rows<order>(res); });
+	run("binary get", binary, with_get);
+	run("binary pg_rows", binary, [](const pg_result& res) { return pg_rows<order>(res); });
+	return 0;
+}
@@ -0,0 +1,83 @@
+// A large result read whole with execute against the same result streamed row by row:
+// time to the first row, total time and peak memory of the process.
+// The streamed run goes first, the peak resident size only grows.
+// usage: bench_stream [rows] [capacity]
+#include <sys/resource.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+namespace {
+
+	long peak_kb() {
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+	}
+
+	double ms_since(std::chrono::steady_clock::time_point t0) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	}
+
+	void report(const char* mode, long rows, double first_ms, double total_ms, long peak_before) {
+		std::printf("%10s %10ld %14.2f %12.1f %14ld\n", mode, rows, first_ms, total_ms, peak_kb() - peak_before);
+	}
+
+}
+
+int main(int argc, char** argv) {
+
+	int rows = argc > 1 ? std::atoi(argv[1]) : 1000000;
+	std::size_t capacity = argc > 2 ? std::atoi(argv[2]) : 1024;
+
+	mock_pg_server::options server_options;
+	server_options.rows = rows;
+	mock_pg_server server(server_options);
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	pg_pool_options options;
+	options.n_connections = 1;
+	async_pg pg(server.connection_params());
+	pg.start(options).get();
+
+	std::printf("rows=%d capacity=%zu\n", rows, capacity);
+	std::printf("%10s %10s %14s %12s %14s\n", "mode", "rows", "first row ms", "total ms", "peak +KB");
+
+	{
+		long peak = peak_kb();
+		auto t0 = std::chrono::steady_clock::now();
+		auto stream = pg.stream("SELECT n FROM big", {}, capacity);
+		double first_ms = 0;
+		long n = 0;
+		std::list<pg_result> batch;
+		while (stream->next_batch(batch, 256)) {
+			if (n == 0) {
+				first_ms = ms_since(t0);
+			}
+			n += (long)batch.size();
+			batch.clear();
+		}
+		report("stream", n, first_ms, ms_since(t0), peak);
+	}
+
+	{
+		long peak = peak_kb();
+		auto t0 = std::chrono::steady_clock::now();
+		auto results = pg.execute("SELECT n FROM big").get();
+		double first_ms = ms_since(t0);
+		long n = results.size() ? results.front().rows_count() : 0;
+		report("execute", n, first_ms, ms_since(t0), peak);
+	}
+
+	pg_stats stats = pg.stats();
+	std::printf("rows_streamed=%llu streams_paused=%llu\n", (unsigned long long)stats.rows_streamed, (unsigned long long)stats.streams_paused);
+
+	pg.stop();
+	server.stop();
+	return 0;
+}
@@ -0,0 +1,65 @@
+// Wakeups caused by a burst of submissions from many producers.
+// usage: bench_submit_burst [connections] [producers] [queries per producer]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+int main(int argc, char** argv) {
+
+	int n_connections = argc > 1 ? std::atoi(argv[1]) : 16;
+	int n_producers = argc > 2 ? std::atoi(argv[2]) : 100;
+	int n_queries = argc > 3 ? std::atoi(argv[3]) : 100;
+
+	mock_pg_server server;
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	async_pg pg(server.connection_params());
+	pg.start(n_connections);
+	pg.execute("select 1").get();
+
+	pg_stats before = pg.stats();
+	auto t0 = std::chrono::steady_clock::now();
+
+	std::vector<std::vector<std::future<std::list<pg_result>>>> futures(n_producers);
+	std::vector<std::thread> producers;
+	for (int p = 0; p < n_producers; ++p) {
+		producers.emplace_back([&pg, &futures, p, n_queries] {
+			futures[p].reserve(n_queries);
+			for (int i = 0; i < n_queries; ++i) {
+				futures[p].push_back(pg.execute("select 1"));
+			}
+		});
+	}
+	for (auto& t : producers) {
+		t.join();
+	}
+
+	auto submitted = std::chrono::steady_clock::now();
+	pg_stats after_submit = pg.stats();
+
+	for (auto& v : futures) {
+		for (auto& f : v) {
+			f.get();
+		}
+	}
+
+	auto t1 = std::chrono::steady_clock::now();
+	pg_stats after = pg.stats();
+	pg.stop();
+	server.stop();
+
+	double n = (double)n_producers * n_queries;
+	std::printf("producers=%d queries=%.0f\n", n_producers, n);
+	std::printf("submit ns/query   %.0f\n", std::chrono::duration<double, std::nano>(submitted - t0).count() / n);
+	std::printf("wakeups in burst  %llu\n", (unsigned long long)(after_submit.wakeups - before.wakeups));
+	std::printf("wakeups total     %llu\n", (unsigned long long)(after.wakeups - before.wakeups));
+	std::printf("qps               %.0f\n", n / std::chrono::duration<double>(t1 - t0).count());
+	return 0;
+}
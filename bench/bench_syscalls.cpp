@@ -0,0 +1,62 @@
+// Syscalls per query of the reactor loop.
+// usage: bench_syscalls [connections] [threads] [queries per thread]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "async_pg/async_pg.hpp"
+#include "mock_pg_server.hpp"
+
+int main(int argc, char** argv) {
+
+	int n_connections = argc > 1 ? std::atoi(argv[1]) : 64;
+	int n_threads = argc > 2 ? std::atoi(argv[2]) : 128;
+	int n_queries = argc > 3 ? std::atoi(argv[3]) : 200;
+
+	mock_pg_server server;
+	if (!server.start()) {
+		std::fprintf(stderr, "mock server failed to start\n");
+		return 1;
+	}
+
+	async_pg pg(server.connection_params());
+	pg.start(n_connections);
+
+	// warm up: let every connection finish its handshake
+	std::vector<std::future<std::list<pg_result>>> warmup;
+	for (int i = 0; i < n_connections * 4; ++i) {
+		warmup.push_back(pg.execute("select 1"));
+	}
+	for (auto& f : warmup) {
+		f.get();
+	}
+
+	pg_stats before = pg.stats();
+	auto t0 = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < n_threads; ++t) {
+		threads.emplace_back([&pg, n_queries] {
+			for (int i = 0; i < n_queries; ++i) {
+				pg.execute("select 1").get();
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	pg_stats after = pg.stats();
+	pg.stop();
+	server.stop();
+
+	double n = (double)(after.queries_completed - before.queries_completed);
+	std::printf("connections=%d threads=%d queries=%.0f\n", n_connections, n_threads, n);
+	std::printf("qps             %.0f\n", n / elapsed);
+	std::printf("epoll_ctl/query %.3f\n", (after.epoll_ctl_calls - before.epoll_ctl_calls) / n);
+	std::printf("epoll_wait/query %.3f\n", (after.epoll_wait_calls - before.epoll_wait_calls) / n);
+	std::printf("wakeups/query   %.3f\n", (after.wakeups - before.wakeups) / n);
+	return 0;
+}
@@ -0,0 +1,591 @@
+#include "mock_pg_server.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+
+	class message {
+	public:
+		message(char type) : _type(type) {}
+
+		message& i16(int16_t v) {
+			uint16_t n = htons((uint16_t)v);
+			_body.append((const char*)&n, 2);
+			return *this;
+		}
+
+		message& i32(int32_t v) {
+			uint32_t n = htonl((uint32_t)v);
+			_body.append((const char*)&n, 4);
+			return *this;
+		}
+
+		message& str(const std::string& s) {
+			_body.append(s);
+			_body.push_back('\0');
+			return *this;
+		}
+
+		message& bytes(const std::string& s) {
+			_body.append(s);
+			return *this;
+		}
+
+		void append_to(std::string& out) const {
+			out.push_back(_type);
+			uint32_t n = htonl((uint32_t)_body.size() + 4);
+			out.append((const char*)&n, 4);
+			out.append(_body);
+		}
+
+	private:
+		char _type;
+		std::string _body;
+	};
+
+	int32_t read_i32(const char* p) {
+		uint32_t n;
+		std::memcpy(&n, p, 4);
+		return (int32_t)ntohl(n);
+	}
+
+	int16_t read_i16(const char* p) {
+		uint16_t n;
+		std::memcpy(&n, p, 2);
+		return (int16_t)ntohs(n);
+	}
+
+	bool read_exact(int fd, char* buf, size_t n) {
+		while (n) {
+			ssize_t r = ::recv(fd, buf, n, 0);
+			if (r <= 0) {
+				return false;
+			}
+			buf += r;
+			n -= r;
+		}
+		return true;
+	}
+
+	bool write_all(int fd, const std::string& data) {
+		size_t off = 0;
+		while (off < data.size()) {
+			ssize_t r = ::send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+			if (r <= 0) {
+				return false;
+			}
+			off += r;
+		}
+		return true;
+	}
+
+	std::string first_word(const std::string& sql) {
+		size_t b = 0;
+		while (b < sql.size() && std::isspace((unsigned char)sql[b])) {
+			++b;
+		}
+		size_t e = b;
+		while (e < sql.size() && std::isalpha((unsigned char)sql[e])) {
+			++e;
+		}
+		std::string w = sql.substr(b, e - b);
+		std::transform(w.begin(), w.end(), w.begin(), [](unsigned char c) { return (char)std::toupper(c); });
+		return w;
+	}
+
+	struct session {
+		std::map<std::string, std::string> statements;
+		std::string portal_sql;
+		bool binary_results = false;
+		bool skip_until_sync = false;
+		// COPY FROM STDIN in progress
+		bool copy_in = false;
+		bool copy_binary = false;
+		bool copy_header = false;	// binary header received
+		bool copy_failed = false;
+		std::string copy_data;		// binary data not parsed yet
+		long copy_rows = 0;
+	};
+
+}
+
+mock_pg_server::mock_pg_server() : mock_pg_server(options()) {}
+
+mock_pg_server::mock_pg_server(options opts) :
+	_opts(opts),
+	_listen_fd(-1),
+	_port(0),
+	_running(false),
+	_refusing(false),
+	_accepted(0)
+{}
+
+mock_pg_server::~mock_pg_server() {
+	stop();
+}
+
+std::map<std::string, std::string> mock_pg_server::connection_params() const {
+	return {
+		{"hostaddr", "127.0.0.1"},
+		{"port", std::to_string(_port)},
+		{"dbname", "mock"},
+		{"user", "mock"},
+		{"sslmode", "disable"},
+		{"gssencmode", "disable"},
+	};
+}
+
+bool mock_pg_server::start() {
+
+	_listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (_listen_fd == -1) {
+		return false;
+	}
+
+	int one = 1;
+	setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if (::bind(_listen_fd, (sockaddr*)&addr, sizeof(addr)) == -1 || ::listen(_listen_fd, 1024) == -1) {
+		::close(_listen_fd);
+		_listen_fd = -1;
+		return false;
+	}
+
+	socklen_t len = sizeof(addr);
+	getsockname(_listen_fd, (sockaddr*)&addr, &len);
+	_port = ntohs(addr.sin_port);
+	_running = true;
+	_acceptor = std::thread(&mock_pg_server::accept_loop, this);
+	return true;
+}
+
+void mock_pg_server::drop_connections() {
+	std::lock_guard<std::mutex> lock(_mtx);
+	for (int fd : _clients) {
+		::shutdown(fd, SHUT_RDWR);
+	}
+}
+
+void mock_pg_server::stop() {
+
+	if (!_running.exchange(false)) {
+		return;
+	}
+
+	::shutdown(_listen_fd, SHUT_RDWR);
+	if (_acceptor.joinable()) {
+		_acceptor.join();
+	}
+	::close(_listen_fd);
+	_listen_fd = -1;
+
+	std::vector<std::thread> workers;
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		for (int fd : _clients) {
+			::shutdown(fd, SHUT_RDWR);
+		}
+		workers.swap(_workers);
+	}
+
+	for (auto& w : workers) {
+		w.join();
+	}
+}
+
+void mock_pg_server::accept_loop() {
+	while (_running) {
+		int fd = ::accept(_listen_fd, nullptr, nullptr);
+		if (fd == -1) {
+			if (!_running) {
+				break;
+			}
+			continue;
+		}
+		++_accepted;
+		if (_refusing) {
+			::close(fd);
+			continue;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		std::lock_guard<std::mutex> lock(_mtx);
+		_clients.insert(fd);
+		_workers.emplace_back(&mock_pg_server::serve, this, fd);
+	}
+}
+
+void mock_pg_server::serve(int fd) {
+
+	// startup: SSLRequest/GSSENCRequest are declined, the StartupMessage is accepted without authentication
+	while (true) {
+		char hdr[8];
+		if (!read_exact(fd, hdr, 8)) {
+			goto done;
+		}
+		int32_t len = read_i32(hdr);
+		int32_t code = read_i32(hdr + 4);
+		std::string rest(std::max(len - 8, 0), '\0');
+		if (!read_exact(fd, &rest[0], rest.size())) {
+			goto done;
+		}
+		if (code == 80877102 && rest.size() >= 4) {
+			// CancelRequest: the pid is the fd of the connection to cancel
+			std::lock_guard<std::mutex> lock(_mtx);
+			_cancelled.insert(read_i32(rest.data()));
+			goto done;
+		}
+		if (code == 80877103 || code == 80877104) {
+			if (!write_all(fd, "N")) {
+				goto done;
+			}
+			continue;
+		}
+		break;
+	}
+
+	{
+		std::string out;
+		message('R').i32(0).append_to(out);
+		message('S').str("server_version").str("15.0").append_to(out);
+		message('S').str("client_encoding").str("UTF8").append_to(out);
+		message('S').str("standard_conforming_strings").str("on").append_to(out);
+		message('S').str("integer_datetimes").str("on").append_to(out);
+		message('S').str("DateStyle").str("ISO, MDY").append_to(out);
+		message('K').i32(fd).i32(fd * 7919).append_to(out);
+		message('Z').bytes("I").append_to(out);
+		if (!write_all(fd, out)) {
+			goto done;
+		}
+	}
+
+	{
+		session s;
+		std::string in;
+		std::string out;
+		char buf[64 * 1024];
+
+		auto row_description = [&](std::string& o) {
+			message('T').i16(1).str("n").i32(0).i16(0).i32(23).i16(4).i32(-1).i16(s.binary_results ? 1 : 0).append_to(o);
+		};
+
+		auto cancelled = [&]() {
+			std::lock_guard<std::mutex> lock(_mtx);
+			return _cancelled.erase(fd) > 0;
+		};
+
+		auto execute = [&](const std::string& sql, std::string& o) {
+			std::string w = first_word(sql);
+			size_t sleep = sql.find("pg_sleep(");
+			if (sleep != std::string::npos) {
+				// statements before it are answered first, as pipelined statements are by the server
+				if (!o.empty()) {
+					if (!write_all(fd, o)) {
+						return false;
+					}
+					o.clear();
+				}
+				// a cancel request sent before the statement started is ignored, like the server does
+				cancelled();
+				auto until = std::chrono::steady_clock::now() + std::chrono::duration<double>(std::atof(sql.c_str() + sleep + 9));
+				while (std::chrono::steady_clock::now() < until) {
+					if (cancelled()) {
+						message('E').bytes("SERROR").bytes(std::string(1, '\0')).bytes("C57014").bytes(std::string(1, '\0'))
+							.bytes("Mcanceling statement due to user request").bytes(std::string(1, '\0')).bytes(std::string(1, '\0')).append_to(o);
+						return false;
+					}
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+			if (sql.find("error") != std::string::npos) {
+				message('E').bytes("SERROR").bytes(std::string(1, '\0')).bytes("C42000").bytes(std::string(1, '\0'))
+					.bytes("Mmock error").bytes(std::string(1, '\0')).bytes(std::string(1, '\0')).append_to(o);
+				return false;
+			}
+			if (w == "SELECT") {
+				for (int r = 0; r < _opts.rows; ++r) {
+					message row('D');
+					row.i16(1);
+					if (s.binary_results) {
+						row.i32(4).i32(r + 1);
+					}
+					else {
+						std::string v = std::to_string(r + 1);
+						row.i32((int32_t)v.size()).bytes(v);
+					}
+					row.append_to(o);
+					// large results are written as they are produced, the client sees the first rows early
+					if (o.size() >= 64 * 1024) {
+						if (!write_all(fd, o)) {
+							return false;
+						}
+						o.clear();
+					}
+				}
+				message('C').str("SELECT " + std::to_string(_opts.rows)).append_to(o);
+			}
+			else if (w == "INSERT") {
+				message('C').str("INSERT 0 1").append_to(o);
+			}
+			else if (w.empty()) {
+				message('I').append_to(o);
+			}
+			else {
+				message('C').str(w == "UPDATE" || w == "DELETE" ? w + " 1" : w).append_to(o);
+			}
+			return true;
+		};
+
+		while (true) {
+			ssize_t r = ::recv(fd, buf, sizeof(buf), 0);
+			if (r <= 0) {
+				break;
+			}
+			in.append(buf, r);
+
+			size_t off = 0;
+			bool terminate = false;
+			while (in.size() - off >= 5) {
+				char type = in[off];
+				int32_t len = read_i32(&in[off + 1]);
+				if (in.size() - off < (size_t)len + 1) {
+					break;
+				}
+				const char* body = &in[off + 5];
+				size_t body_len = len - 4;
+				off += len + 1;
+
+				if (s.skip_until_sync && type != 'S') {
+					continue;
+				}
+
+				switch (type) {
+				case 'Q': {
+					std::string sql(body, strnlen(body, body_len));
+					s.binary_results = false;
+					if (first_word(sql) == "COPY") {
+						// of one column, out or in
+						std::string upper = sql;
+						std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) { return (char)std::toupper(c); });
+						bool binary = upper.find("BINARY") != std::string::npos;
+						if (upper.find("TO STDOUT") != std::string::npos) {
+							// CopyOutResponse, the rows as CopyData and CopyDone
+							message('H').bytes(std::string(1, binary ? 1 : 0)).i16(1).i16(binary ? 1 : 0).append_to(out);
+							for (int r = 0; r < _opts.rows; ++r) {
+								message('d').bytes(std::to_string(r + 1) + "\n").append_to(out);
+								if (out.size() >= 64 * 1024) {
+									if (!write_all(fd, out)) {
+										break;
+									}
+									out.clear();
+								}
+							}
+							message('c').append_to(out);
+							message('C').str("COPY " + std::to_string(_opts.rows)).append_to(out);
+							message('Z').bytes("I").append_to(out);
+							break;
+						}
+						// CopyInResponse, the server then waits for CopyData
+						s.copy_in = true;
+						s.copy_binary = binary;
+						s.copy_header = false;
+						s.copy_failed = false;
+						s.copy_data.clear();
+						s.copy_rows = 0;
+						message('G').bytes(std::string(1, s.copy_binary ? 1 : 0)).i16(1).i16(s.copy_binary ? 1 : 0).append_to(out);
+						break;
+					}
+					if (sql.find_first_not_of(" \t\n;") == std::string::npos) {
+						message('I').append_to(out);
+					}
+					else {
+						size_t b = 0;
+						while (b < sql.size()) {
+							size_t e = sql.find(';', b);
+							if (e == std::string::npos) {
+								e = sql.size();
+							}
+							std::string stmt = sql.substr(b, e - b);
+							b = e + 1;
+							if (stmt.find_first_not_of(" \t\n") == std::string::npos) {
+								continue;
+							}
+							if (first_word(stmt) == "SELECT") {
+								row_description(out);
+							}
+							if (!execute(stmt, out)) {
+								break;
+							}
+						}
+					}
+					message('Z').bytes("I").append_to(out);
+					break;
+				}
+				case 'P': {
+					std::string name(body);
+					std::string sql(body + name.size() + 1);
+					if (sql.find("syntax error") != std::string::npos) {
+						message('E').bytes("SERROR").bytes(std::string(1, '\0')).bytes("C42601").bytes(std::string(1, '\0'))
+							.bytes("Mmock syntax error").bytes(std::string(1, '\0')).bytes(std::string(1, '\0')).append_to(out);
+						s.skip_until_sync = true;
+						break;
+					}
+					s.statements[name] = sql;
+					message('1').append_to(out);
+					break;
+				}
+				case 'B': {
+					const char* p = body;
+					p += strlen(p) + 1; // portal
+					std::string stmt(p);
+					p += stmt.size() + 1;
+					int16_t n_formats = read_i16(p);
+					p += 2 + n_formats * 2;
+					int16_t n_params = read_i16(p);
+					p += 2;
+					for (int i = 0; i < n_params; ++i) {
+						int32_t plen = read_i32(p);
+						p += 4 + std::max(plen, 0);
+					}
+					int16_t n_result_formats = read_i16(p);
+					p += 2;
+					s.binary_results = n_result_formats > 0 && read_i16(p) == 1;
+					s.portal_sql = s.statements.count(stmt) ? s.statements[stmt] : std::string();
+					message('2').append_to(out);
+					break;
+				}
+				case 'D': {
+					if (body[0] == 'S') {
+						message('t').i16(0).append_to(out);
+						std::string name(body + 1);
+						s.portal_sql = s.statements.count(name) ? s.statements[name] : std::string();
+					}
+					if (first_word(s.portal_sql) == "SELECT") {
+						row_description(out);
+					}
+					else {
+						message('n').append_to(out);
+					}
+					break;
+				}
+				case 'E':
+					if (!execute(s.portal_sql, out)) {
+						s.skip_until_sync = true;
+					}
+					break;
+				case 'C':
+					message('3').append_to(out);
+					break;
+				case 'd': {
+					// rows are counted, text rows end with a newline and a row containing "error" fails the copy
+					if (!s.copy_in) {
+						break;
+					}
+					if (!s.copy_binary) {
+						std::string data(body, body_len);
+						s.copy_rows += std::count(data.begin(), data.end(), '\n');
+						s.copy_failed = s.copy_failed || data.find("error") != std::string::npos;
+						break;
+					}
+					s.copy_data.append(body, body_len);
+					size_t p = 0;
+					if (!s.copy_header) {
+						if (s.copy_data.size() < 19) {
+							break;
+						}
+						s.copy_header = true;
+						p = 19;
+					}
+					while (s.copy_data.size() - p >= 2) {
+						int16_t fields = read_i16(&s.copy_data[p]);
+						if (fields == -1) {
+							p += 2;
+							continue;
+						}
+						size_t q = p + 2;
+						bool complete = true;
+						for (int f = 0; f < fields; ++f) {
+							if (s.copy_data.size() - q < 4) {
+								complete = false;
+								break;
+							}
+							int32_t flen = read_i32(&s.copy_data[q]);
+							q += 4 + std::max(flen, 0);
+							if (q > s.copy_data.size()) {
+								complete = false;
+								break;
+							}
+						}
+						if (!complete) {
+							break;
+						}
+						p = q;
+						++s.copy_rows;
+					}
+					s.copy_data.erase(0, p);
+					break;
+				}
+				case 'c':
+					if (s.copy_failed) {
+						message('E').bytes("SERROR").bytes(std::string(1, '\0')).bytes("C22P02").bytes(std::string(1, '\0'))
+							.bytes("Mmock copy error").bytes(std::string(1, '\0')).bytes(std::string(1, '\0')).append_to(out);
+					}
+					else {
+						message('C').str("COPY " + std::to_string(s.copy_rows)).append_to(out);
+					}
+					message('Z').bytes("I").append_to(out);
+					s.copy_in = false;
+					break;
+				case 'f':
+					message('E').bytes("SERROR").bytes(std::string(1, '\0')).bytes("C57014").bytes(std::string(1, '\0'))
+						.bytes("MCOPY from stdin failed: " + std::string(body, strnlen(body, body_len))).bytes(std::string(1, '\0')).bytes(std::string(1, '\0')).append_to(out);
+					message('Z').bytes("I").append_to(out);
+					s.copy_in = false;
+					break;
+				case 'S':
+					s.skip_until_sync = false;
+					message('Z').bytes("I").append_to(out);
+					break;
+				case 'X':
+					terminate = true;
+					break;
+				default:
+					break;
+				}
+			}
+			in.erase(0, off);
+
+			if (!out.empty()) {
+				if (_opts.rtt_us > 0) {
+					std::this_thread::sleep_for(std::chrono::microseconds(_opts.rtt_us));
+				}
+				if (!write_all(fd, out)) {
+					break;
+				}
+				out.clear();
+			}
+
+			if (terminate) {
+				break;
+			}
+		}
+	}
+
+done:
+	std::lock_guard<std::mutex> lock(_mtx);
+	_clients.erase(fd);
+	::close(fd);
+}
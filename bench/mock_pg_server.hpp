@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal PostgreSQL v3 wire protocol server used by the benchmarks.
+// Every connection is served by its own thread. SELECT statements return
+// `rows` rows of a single int4 column "n", everything else just completes.
+// Large results are written in 64 KB chunks while they are produced.
+// COPY ... FROM STDIN counts the rows it receives, in text or binary format;
+// a text row containing "error" fails the copy. COPY ... TO STDOUT sends the `rows` rows a SELECT returns, as text.
+// Responses to whatever arrived in one read are held back for `rtt_us`
+// before they are flushed, which simulates network round trip time.
+// pg_sleep(seconds) in a statement delays it until it is cancelled with a CancelRequest,
+// the responses to the statements before it are flushed first.
+class mock_pg_server {
+public:
+	struct options {
+		int rtt_us = 0;
+		int rows = 1;
+	};
+
+	mock_pg_server();
+	mock_pg_server(options opts);
+	~mock_pg_server();
+
+	bool start();
+	void stop();
+	// closes every client connection, as a server restart would, and keeps accepting new ones
+	void drop_connections();
+	// while set, new connections are closed as soon as they are accepted, as by a server still starting up
+	void refuse_connections(bool refuse) { _refusing = refuse; }
+	// connections accepted so far, refused ones included
+	int accepted() const { return _accepted; }
+
+	int port() const { return _port; }
+	std::map<std::string, std::string> connection_params() const;
+
+private:
+	void accept_loop();
+	void serve(int fd);
+
+	options _opts;
+	int _listen_fd;
+	int _port;
+	std::atomic<bool> _running;
+	std::atomic<bool> _refusing;
+	std::atomic<int> _accepted;
+	std::thread _acceptor;
+	std::mutex _mtx;
+	std::set<int> _clients;
+	std::set<int> _cancelled;	// backend pids (the client fd) with a pending cancel request
+	std::vector<std::thread> _workers;
+};
@@ -1,39 +1,7 @@
 #include "async_pg.hpp"
-#include <sys/epoll.h>
-#include <sys/ioctl.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <memory>
-#include <errno.h>
-#include <unordered_map>
-#include <string.h>
-#include "pg_connection.hpp"
-
-#define log_error(...) printf(__VA_ARGS__); printf("\n")
-#define log_info(...) printf(__VA_ARGS__); printf("\n")
-
-
-// Rules:
-// 1. Don't call PQconsumeInput on PGRES_POLLING_READING.
-//		If you call PQconsumeInput on PGRES_POLLING_READING, 
-//		you will stuck in receiving PGRES_POLLING_READING for PQconnectStatus
-// 2. You shouldn't call PQflush on PGRES_POLLING_WRITING as well.
-//		Of course, there were no problem when I call PQflush, but, 
-//		to respect 1st rule don't call PQflush.
-// 3. After PQconnectStart, you MUST always call PQconnectStatus, 
-//		until it returns PGRES_POLLING_OK or PGRES_POLLING_FAILED.
-//		First time call PQconnectStatus, it returns PGRES_POLLING_WRITING.
-//		You need to wait until socket will be writable.
-//		On next call, PQconnectStatus returns PGRES_POLLING_READING.
-//		It doesn't matter how much time passed between PQconnectStart and PQconnectStatus.
-//		Even if I put sleep between calls to PQconnectStatus, the return value order is the same
-//
-// 4. You cannot know if connection failed after success connect. 
-//		You can know it only when you try to send some command to that connection.
-//		Otherwise, you will always get PGRES_POLLING_OK.
-// 5. Call PQgetResult until it returns nullptr. Even if you that only one result will return, 
-//		call it until it returns nullptr. If you don't do that, next PQsendQuery call returns FALSE.
-// 6. If PQisBusy returns TRUE, wait for read- and write- ready
+#include <algorithm>
+#include <stdexcept>
+#include "pg_reactor.hpp"
 
 async_pg::async_pg(std::string connection_string) :
 	async_pg({ {"dbname", connection_string} }) {}
@@ -50,330 +18,496 @@ async_pg::async_pg(std::string ip, std::string port, std::string dbname, std::st
 async_pg::async_pg(std::map<std::string, std::string> params) {
 	_connection_params = params;
 	_running = false;
-	_notifiy_fd = -1;
-	_wait_fd = -1;
-
-	int pipes[2];
-	if (pipe(pipes) == -1) {
-		std::string error = strerror(errno);
-		throw std::runtime_error("pipe() failed: " + error);
-	}
-	_wait_fd = pipes[0];
-	_notifiy_fd = pipes[1];
+	_embedded = false;
+	_next_reactor = 0;
+	_block_when_full = true;
+	_queries_rejected = 0;
 }
 
 async_pg::~async_pg() {
 	if (_running) {
 		stop();
 	}
+	// before the members the drained queries are handed to
+	publish(nullptr);
+	_reactors.reset();
+}
 
-	if (_wait_fd != -1) {
-		close(_wait_fd);
-	}
-
-	if (_notifiy_fd != -1) {
-		close(_notifiy_fd);
-	}
+std::shared_future<void> async_pg::start(int n_connections) {
+	pg_pool_options options;
+	options.n_connections = n_connections;
+	return start(options);
 }
 
-void async_pg::start(int n_connections) {
+std::shared_future<void> async_pg::start(const pg_pool_options& options) {
 
 	std::lock_guard<std::mutex> lock(_mtx);
-	if (!_running) {
-		_running = true;
-		_thr = std::thread(&async_pg::process, this, n_connections);
+	if (_running) {
+		return _readiness.future();
 	}
 
+	auto ready = _readiness.reset(std::min(options.ready_connections, options.n_connections));
+
+	_block_when_full = options.queue_full == pg_pool_options::queue_full_t::block;
+	_admission.open(options.queue_capacity);
+
+	// Reactors are reused if the pool is restarted with as many of them in the same mode,
+	// otherwise they are created again: every reactor gets at least one connection.
+	// Queries submitted meanwhile wait in _pending.
+	int n_reactors = options.embedded ? 1 : std::max(1, std::min(options.n_reactors, options.n_connections));
+	if (!_reactors || (int)_reactors->size() != n_reactors || _embedded != options.embedded) {
+		publish(nullptr);
+		auto set = std::make_unique<reactors>();
+		for (int i = 0; i < n_reactors; ++i) {
+			set->emplace_back(new pg_reactor(i, _connection_params, _admission, _readiness));
+		}
+		for (auto& r : *set) {
+			std::vector<pg_reactor*> siblings;
+			for (auto& other : *set) {
+				if (other != r) {
+					siblings.push_back(other.get());
+				}
+			}
+			r->set_siblings(std::move(siblings));
+		}
+		_reactors = std::shared_ptr<const reactors>(set.release(), [this](const reactors* stopped) {
+			for (auto& r : *stopped) {
+				r->drain(_pending);
+			}
+			delete stopped;
+			dispatch_pending();
+		});
+	}
+
+	int max_connections = std::max(options.n_connections, options.max_connections);
+	int first_id = 1;
+	for (int i = 0; i < n_reactors; ++i) {
+		int n = options.n_connections / n_reactors + (i < options.n_connections % n_reactors ? 1 : 0);
+		int max = max_connections / n_reactors + (i < max_connections % n_reactors ? 1 : 0);
+		int cpu = options.cpus.empty() ? -1 : options.cpus[i % options.cpus.size()];
+		pg_reactor& r = *(*_reactors)[i];
+		r.set_registry(_registry);
+		if (options.embedded) {
+			r.start_embedded(first_id, n, std::max(n, max), options);
+		}
+		else {
+			r.start(first_id, n, std::max(n, max), options, cpu);
+		}
+		first_id += std::max(n, max);
+	}
+
+	_running = true;
+	_embedded = options.embedded;
+	publish(_reactors);
+	dispatch_pending();
+	return ready;
 }
 
 void async_pg::stop() {
 
-	std::unique_lock<std::mutex> lock(_mtx);
+	std::lock_guard<std::mutex> lock(_mtx);
 	if (_running) {
 		_running = false;
-		lock.unlock();
-		cond_notify();
-		if (_thr.joinable()) {
-			_thr.join();
+		_admission.close();
+		_readiness.abandon("stopping service");
+		for (auto& r : *_reactors) {
+			if (_embedded) {
+				r->stop_embedded();
+			}
+			else {
+				r->request_stop();
+			}
+		}
+		for (auto& r : *_reactors) {
+			r->join();
 		}
 	}
 
 }
 
-std::future<std::list<pg_result>> async_pg::execute(std::string&& sql, std::list<pg_param>&& params) {
+void async_pg::execute(const std::string& sql, const std::list<pg_param>& params, pg_completion_queue& queue, void* tag, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
+	execute(sql, params, [&queue, tag](std::exception_ptr error, std::list<pg_result>&& results) {
+		queue.push(tag, error, std::move(results));
+	}, nullptr, timeout, idempotent, format);
+}
 
-	pg_query query(std::move(sql), std::move(params));
-	auto future = query.get_future();
+void async_pg::execute_prepared(const pg_prepared& statement, const std::list<pg_param>& params, pg_completion_queue& queue, void* tag, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
+	execute_prepared(statement, params, [&queue, tag](std::exception_ptr error, std::list<pg_result>&& results) {
+		queue.push(tag, error, std::move(results));
+	}, nullptr, timeout, idempotent, format);
+}
 
-	std::lock_guard<std::mutex> lock(_mtx);
-	_queries.push_back(std::move(query));
-	cond_notify();
-	return future;
+void async_pg::execute_batch(std::vector<pg_statement>&& statements, bool transaction, pg_completion_queue& queue, void* tag) {
+	execute_batch(std::move(statements), transaction, [&queue, tag](std::exception_ptr error, std::list<pg_result>&& results) {
+		queue.push(tag, error, std::move(results));
+	});
 }
 
-std::future<std::list<pg_result>> async_pg::execute(const std::string& sql, const std::list<pg_param>& params) {
+int async_pg::fd() const {
+	return _embedded && _reactors ? (*_reactors)[0]->fd() : -1;
+}
 
-	pg_query query(sql, params);
-	auto future = query.get_future();
+int async_pg::timeout() {
+	return _embedded && _reactors ? (*_reactors)[0]->timeout() : -1;
+}
 
-	std::lock_guard<std::mutex> lock(_mtx);
-	_queries.push_back(std::move(query));
-	cond_notify();
+void async_pg::run_once(int timeout_ms) {
+	if (_embedded && _reactors) {
+		(*_reactors)[0]->run_once(timeout_ms);
+	}
+}
+
+std::future<std::list<pg_result>> async_pg::execute(std::string&& sql, std::list<pg_param>&& params, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
+
+	pg_query* query = new pg_query(std::move(sql), std::move(params));
+	auto future = query->get_future();
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	query->set_idempotent(idempotent);
+	query->set_format(format);
+	admit(query);
 	return future;
 }
 
-std::future<std::list<pg_result>> async_pg::execute_prepared(std::string&& name, std::string&& sql, std::list<pg_param>&& params) {
+std::future<std::list<pg_result>> async_pg::execute(const std::string& sql, const std::list<pg_param>& params, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
 
-	pg_query query(std::move(name), std::move(sql), std::move(params));
-	auto future = query.get_future();
+	pg_query* query = new pg_query(sql, params);
+	auto future = query->get_future();
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	query->set_idempotent(idempotent);
+	query->set_format(format);
+	admit(query);
+	return future;
+}
 
-	std::lock_guard<std::mutex> lock(_mtx);
-	_queries.push_back(std::move(query));
-	cond_notify();
+std::future<std::list<pg_result>> async_pg::execute_prepared(std::string&& name, std::string&& sql, std::list<pg_param>&& params, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
+
+	pg_query* query = new pg_query(std::move(name), std::move(sql), std::move(params));
+	auto future = query->get_future();
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	query->set_idempotent(idempotent);
+	query->set_format(format);
+	admit(query);
 	return future;
 }
 
-std::future<std::list<pg_result>> async_pg::execute_prepared(const std::string& name, const std::string& sql, const std::list<pg_param>& params) {
+std::future<std::list<pg_result>> async_pg::execute_prepared(const std::string& name, const std::string& sql, const std::list<pg_param>& params, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
+
+	pg_query* query = new pg_query(name, sql, params);
+	auto future = query->get_future();
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	query->set_idempotent(idempotent);
+	query->set_format(format);
+	admit(query);
+	return future;
+}
 
-	pg_query query(name, sql, params);
-	auto future = query.get_future();
+std::optional<std::future<std::list<pg_result>>> async_pg::try_execute(const std::string& sql, const std::list<pg_param>& params, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
 
-	std::lock_guard<std::mutex> lock(_mtx);
-	_queries.push_back(std::move(query));
-	cond_notify();
+	if (!try_admit()) {
+		return std::nullopt;
+	}
+	pg_query* query = new pg_query(sql, params);
+	auto future = query->get_future();
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	query->set_idempotent(idempotent);
+	query->set_format(format);
+	submit(query);
 	return future;
 }
 
-void async_pg::process(int n_connections) {
-	
-	std::vector<std::shared_ptr<pg_connection>> connections;
-	for (int i = 0; i < n_connections; ++i) {
-		auto conn = std::make_shared<pg_connection>(i + 1);
-		if (conn->start_connect(_connection_params)) {
-			connections.push_back(conn);
-		}
-		else {
-			log_error("\t[%02d] start_connect -> %s", conn->id(), conn->last_error().c_str());
-		}
+std::optional<std::future<std::list<pg_result>>> async_pg::try_execute_prepared(const pg_prepared& statement, const std::list<pg_param>& params, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
+
+	if (!try_admit()) {
+		return std::nullopt;
 	}
-	
-	if (connections.empty()) {
-		log_error("\tasync_pg service failed. no success connections");
-		return;
+	pg_query* query = new pg_query(statement.name(), statement.sql(), params);
+	auto future = query->get_future();
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
 	}
+	query->set_idempotent(idempotent);
+	query->set_format(format);
+	submit(query);
+	return future;
+}
 
-	int efd = epoll_create1(0);
+pg_prepared async_pg::prepare(const std::string& name, const std::string& sql, const std::vector<Oid>& param_types) {
 
-	{
-		epoll_event e;
-		e.events = EPOLLIN;
-		e.data.fd = _wait_fd;
-		if (epoll_ctl(efd, EPOLL_CTL_ADD, _wait_fd, &e) == -1) {
-			log_error("failed to add _wait_fd to epoll");
-			return;
+	std::lock_guard<std::mutex> lock(_mtx);
+	if (_registry) {
+		for (auto& st : *_registry) {
+			if (st.name() != name) {
+				continue;
+			}
+			if (st.sql() != sql || st.param_types() != param_types) {
+				throw std::runtime_error("prepared statement " + name + " is already registered with another statement");
+			}
+			return st;
 		}
 	}
-		
-	epoll_event* events = new epoll_event[n_connections];
-	std::unordered_map<int, std::shared_ptr<pg_connection>> scheduled_connections;
-	std::list<pg_query> queries;
-	std::unordered_map<int, pg_query> scheduled_queries;
 
-	while (true) {
+	// reactors keep the previous registry until they pick up the new one
+	auto registry = _registry ? std::make_shared<std::vector<pg_prepared>>(*_registry) : std::make_shared<std::vector<pg_prepared>>();
+	registry->emplace_back(name, sql, param_types);
+	_registry = registry;
 
-		{
-			std::lock_guard<std::mutex> lock(_mtx);
-			if (!_running) {
-				break;
-			}
+	if (_running) {
+		for (auto& r : *_reactors) {
+			r->set_registry(_registry);
 		}
+	}
+	return registry->back();
+}
 
-		// schedule events
-		for (auto conn: connections) {
-			epoll_event event;
-			event.events = EPOLLERR;
-
-			// conn->connectPoll() might change async_state of connection
-			if (conn->async_state() == pg_connection::async_state_t::connecting) {
-				log_info("[%02d] async_state_t::connecting", conn->id());
-				PostgresPollingStatusType s = conn->connectPoll();
-				if (s == PostgresPollingStatusType::PGRES_POLLING_READING) {
-					event.events |= EPOLLIN;
-				}
-				else if (s == PostgresPollingStatusType::PGRES_POLLING_WRITING) {
-					event.events |= EPOLLOUT;
-				}
-			}
+std::future<std::list<pg_result>> async_pg::execute_prepared(const pg_prepared& statement, std::list<pg_param>&& params, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
+	return execute_prepared(std::string(statement.name()), std::string(statement.sql()), std::move(params), timeout, idempotent, format);
+}
 
-			// conn->resetPoll() might change async_state of connection
-			if (conn->async_state() == pg_connection::async_state_t::resetting) {
-				log_info("[%02d] async_state_t::resetting", conn->id());
-				PostgresPollingStatusType s = conn->resetPoll();
-				if (s == PostgresPollingStatusType::PGRES_POLLING_READING) {
-					event.events |= EPOLLIN;
-				}
-				else if (s == PostgresPollingStatusType::PGRES_POLLING_WRITING) {
-					event.events |= EPOLLOUT;
-				}
-			}
+std::future<std::list<pg_result>> async_pg::execute_prepared(const pg_prepared& statement, const std::list<pg_param>& params, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
+	return execute_prepared(statement.name(), statement.sql(), params, timeout, idempotent, format);
+}
 
-			if (conn->async_state() == pg_connection::async_state_t::connection_failed) {
-				log_info("[%02d] async_state_t::connection_failed: %s", conn->id(), conn->last_error().c_str());
-				if (!conn->start_connect(_connection_params)) {
-					log_error("\t[%02d] start_connect -> %s", conn->id(), conn->last_error().c_str());
-				}
-			}
+std::future<std::list<pg_result>> async_pg::execute_batch(std::vector<pg_statement>&& statements, bool transaction) {
 
-			if (conn->async_state() == pg_connection::async_state_t::connection_abort) {
-				log_info("[%02d] async_state_t::connection_abort: %s", conn->id(), conn->last_error().c_str());
-				if (!conn->start_reset()) {
-					log_error("\t[%02d] start_reset -> %s", conn->id(), conn->last_error().c_str());
-				}
-			}
+	pg_query* query = new pg_query(std::move(statements), transaction);
+	auto future = query->get_future();
+	if (!query->is_batch()) {
+		query->set_result({});
+		delete query;
+		return future;
+	}
+	admit(query);
+	return future;
+}
 
-			if (conn->async_state() == pg_connection::async_state_t::executing_query) {
-				
-				if (conn->poll_read()) {
-					event.events |= EPOLLIN;
-				}
+std::future<std::list<pg_result>> async_pg::execute_batch(const std::vector<pg_statement>& statements, bool transaction) {
+	return execute_batch(std::vector<pg_statement>(statements), transaction);
+}
 
-				if (conn->poll_write()) {
-					event.events |= EPOLLOUT;
-				}
+void async_pg::execute(const std::string& sql, const std::list<pg_param>& params, pg_callback callback, pg_executor* executor, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
 
-			}
+	pg_query* query = new pg_query(sql, params);
+	query->set_callback(std::move(callback), executor);
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	query->set_idempotent(idempotent);
+	query->set_format(format);
+	admit(query);
+}
 
-			if (conn->async_state() == pg_connection::async_state_t::idle) {
-
-				if (queries.size()) {
-					if (queries.front().name().empty()) {
-						if (conn->start_send_query(queries.front().sql(), queries.front().params())) {
-							scheduled_queries[conn->id()] = std::move(queries.front());
-							queries.pop_front();
-						}
-						else {
-							log_error("[%02d] start_send_query -> %s", conn->id(), conn->last_error().c_str());
-						}
-					}
-					else if (conn->has_prepared_statement(queries.front().name())) {
-						if (conn->start_send_prepared_query(queries.front().name(), queries.front().params())) {
-							scheduled_queries[conn->id()] = std::move(queries.front());
-							queries.pop_front();
-						}
-						else {
-							log_error("[%02d] start_send_prepared_query -> %s", conn->id(), conn->last_error().c_str());
-						}
-					}
-					else {
-						if (!conn->start_send_prepared_statement(queries.front().name(), queries.front().sql())) {
-							log_error("[%02d] start_send_prepared_statement -> %s", conn->id(), conn->last_error().c_str());
-						}
-					}
-				}
+void async_pg::execute_prepared(const pg_prepared& statement, const std::list<pg_param>& params, pg_callback callback, pg_executor* executor, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
 
-				if (conn->poll_read()) {
-					event.events |= EPOLLIN;
-				}
+	pg_query* query = new pg_query(statement.name(), statement.sql(), params);
+	query->set_callback(std::move(callback), executor);
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	query->set_idempotent(idempotent);
+	query->set_format(format);
+	admit(query);
+}
 
-				if (conn->poll_write()) {
-					event.events |= EPOLLOUT;
-				}
-			}
+void async_pg::execute_batch(std::vector<pg_statement>&& statements, bool transaction, pg_callback callback, pg_executor* executor) {
 
-			if (event.events & EPOLLIN || event.events & EPOLLOUT) {
-				int sock = conn->socket();
-				event.data.fd = sock;
-				if (epoll_ctl(efd, EPOLL_CTL_ADD, sock, &event) == 0) {
-					scheduled_connections[sock] = conn;
+	pg_query* query = new pg_query(std::move(statements), transaction);
+	query->set_callback(std::move(callback), executor);
+	if (!query->is_batch()) {
+		query->set_result({});
+		delete query;
+		return;
+	}
+	admit(query);
+}
+
+std::shared_ptr<pg_stream> async_pg::stream(const std::string& sql, const std::list<pg_param>& params, std::size_t capacity, std::chrono::milliseconds timeout, pg_format format) {
+	return admit_stream(new pg_query(sql, params), capacity, timeout, format);
+}
+
+std::shared_ptr<pg_stream> async_pg::stream_prepared(const pg_prepared& statement, const std::list<pg_param>& params, std::size_t capacity, std::chrono::milliseconds timeout, pg_format format) {
+	return admit_stream(new pg_query(statement.name(), statement.sql(), params), capacity, timeout, format);
+}
+
+std::shared_ptr<pg_stream> async_pg::admit_stream(pg_query* query, std::size_t capacity, std::chrono::milliseconds timeout, pg_format format) {
+
+	// the completion ends the stream, with the final result or the error
+	auto stream = std::make_shared<pg_stream>(capacity);
+	query->set_callback([stream](std::exception_ptr error, std::list<pg_result>&& results) {
+		stream->finish(error, std::move(results));
+	});
+	query->set_stream(stream);
+	query->set_format(format);
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	admit(query);
+	return stream;
+}
+
+std::shared_ptr<pg_copy_writer> async_pg::copy_in(const std::string& sql, std::size_t capacity, std::chrono::milliseconds timeout) {
+
+	// The completion ends the copy, with the COPY result or the error.
+	// The query holds the state and not the writer, a writer dropped early aborts the copy.
+	auto state = std::make_shared<pg_copy_state>(capacity);
+	auto writer = std::make_shared<pg_copy_writer>(state);
+	pg_query* query = new pg_query(sql);
+	query->set_callback([state](std::exception_ptr error, std::list<pg_result>&& results) {
+		state->complete(error, std::move(results));
+	});
+	query->set_copy(state);
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	admit(query);
+	return writer;
+}
+
+std::future<std::list<pg_result>> async_pg::copy_out(const std::string& sql, pg_copy_sink& sink, std::chrono::milliseconds timeout) {
+
+	// the sink ends before the future is set, its data is complete once the future is ready
+	std::promise<std::list<pg_result>> promise;
+	auto future = promise.get_future();
+	pg_query* query = new pg_query(sql);
+	query->set_callback([&sink, promise = std::move(promise)](std::exception_ptr error, std::list<pg_result>&& results) mutable {
+		for (auto& r : results) {
+			try {
+				r.check();
+			}
+			catch (...) {
+				if (!error) {
+					error = std::current_exception();
 				}
 			}
-			
 		}
-
-		// wait for events
-		int n_events = epoll_wait(efd, events, n_connections, 400);
-		if (n_events == -1) {
-			log_error("epoll_wait -> %d", errno);
+		sink.finish(error);
+		if (error) {
+			promise.set_exception(error);
+		}
+		else {
+			promise.set_value(std::move(results));
 		}
+	});
+	query->set_sink(&sink);
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	admit(query);
+	return future;
+}
 
-		// read events
-		for (int i = 0; i < n_events; ++i) {
-			epoll_event event = events[i];
-			if (scheduled_connections.count(event.data.fd)) {
-				auto conn = scheduled_connections.at(event.data.fd);
-				if (conn->async_state() == pg_connection::async_state_t::executing_query) {
-
-					if (event.events & EPOLLIN) {
-						conn->read();
-					}
-					if (event.events & EPOLLOUT) {
-						conn->write();
-					}
-
-					std::list<pg_result> results;
-					if (conn->get_results(results)) {
-						if (scheduled_queries.count(conn->id())) {
-							scheduled_queries.at(conn->id()).set_result(std::move(results));
-							scheduled_queries.erase(conn->id());
-						}
-						else {
-							for (auto& r : results) {
-								try {
-									r.check();
-								}
-								catch (const std::exception& e) {
-									log_error("%s", e.what());
-								}
-							}
-						}
-					}
-				}
-				
-				if (event.events & EPOLLERR) {
-					log_error("\t[%02d] EPOLLERR", conn->id());
-				}
+pg_awaitable async_pg::query(const std::string& sql, const std::list<pg_param>& params, pg_executor* executor, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
 
-				epoll_ctl(efd, EPOLL_CTL_DEL, event.data.fd, nullptr);
-				scheduled_connections.erase(event.data.fd);
-			}
-			else if (event.data.fd == _wait_fd) {
-				cond_reset();
-			}
+	std::unique_ptr<pg_query> query(new pg_query(sql, params));
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	query->set_idempotent(idempotent);
+	query->set_format(format);
+	return pg_awaitable(*this, std::move(query), executor);
+}
 
-		}
+pg_awaitable async_pg::query_prepared(const pg_prepared& statement, const std::list<pg_param>& params, pg_executor* executor, std::chrono::milliseconds timeout, bool idempotent, pg_format format) {
 
-		// get new requests
-		std::lock_guard<std::mutex> lock(_mtx);
-		if (_queries.size() > 0) {
-			for (pg_query& q : _queries) {
-				queries.push_back(std::move(q));
-			}
-			_queries.clear();
+	std::unique_ptr<pg_query> query(new pg_query(statement.name(), statement.sql(), params));
+	if (timeout.count() > 0) {
+		query->set_timeout(timeout);
+	}
+	query->set_idempotent(idempotent);
+	query->set_format(format);
+	return pg_awaitable(*this, std::move(query), executor);
+}
+
+pg_awaitable async_pg::query_batch(std::vector<pg_statement>&& statements, bool transaction, pg_executor* executor) {
+	if (statements.empty()) {
+		return pg_awaitable(*this, nullptr, executor);
+	}
+	return pg_awaitable(*this, std::unique_ptr<pg_query>(new pg_query(std::move(statements), transaction)), executor);
+}
+
+pg_stats async_pg::stats() const {
+	pg_stats s;
+	if (auto set = snapshot()) {
+		for (auto& r : *set) {
+			r->add_stats(s);
 		}
 	}
+	s.queries_rejected = _queries_rejected.load(std::memory_order_relaxed);
+	return s;
+}
+
+void async_pg::admit(pg_query* query) {
 
-	for(auto& pair: scheduled_queries) {
-		pair.second.set_error("stopping service");
+	// overload is rejected before the query takes a place in the queue
+	const char* error = nullptr;
+	if (_admission.overloaded()) {
+		error = "overloaded";
+	}
+	else if (_block_when_full.load(std::memory_order_relaxed)) {
+		if (!_admission.acquire()) {
+			error = "stopping service";
+		}
+	}
+	else if (!_admission.try_acquire()) {
+		error = _admission.closed() ? "stopping service" : "queue full";
 	}
 
-	for(auto& query: queries) {
-		query.set_error("stopping service");
+	if (error) {
+		_queries_rejected.fetch_add(1, std::memory_order_relaxed);
+		query->set_error(error);
+		delete query;
+		return;
 	}
+	submit(query);
+}
 
-	close(efd);
-	delete[] events;
+bool async_pg::try_admit() {
+	if (_admission.overloaded() || !_admission.try_acquire()) {
+		_queries_rejected.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
 }
 
-void async_pg::cond_notify() {
-	char byte;
-	write(_notifiy_fd, &byte, 1);
+void async_pg::submit(pg_query* query) {
+
+	auto set = snapshot();
+	if (!set) {
+		// not started yet, handed over to the reactors by start()
+		_pending.push(query);
+		if (snapshot()) {
+			dispatch_pending();
+		}
+		return;
+	}
+
+	std::size_t n = set->size();
+	std::size_t i = n == 1 ? 0 : _next_reactor.fetch_add(1, std::memory_order_relaxed) % n;
+	(*set)[i]->submit(query);
 }
 
-void async_pg::cond_reset() {
-	int bytes_available;
-	if(ioctl(_wait_fd, FIONREAD, &bytes_available) == 0 && bytes_available > 0) {
-		char* dummy = new char[bytes_available];
-		read(_wait_fd, dummy, bytes_available);
-		delete[] dummy;
+void async_pg::dispatch_pending() {
+	// pop_all detaches the whole chain atomically, so start() and a racing producer can both call it
+	for (pg_query* q = _pending.pop_all(); q;) {
+		pg_query* next = q->next();
+		submit(q);
+		q = next;
 	}
-}
\ No newline at end of file
+}
+
+void async_pg::publish(std::shared_ptr<const reactors> set) {
+	std::atomic_store(&_published, std::move(set));
+}
+
+std::shared_ptr<const async_pg::reactors> async_pg::snapshot() const {
+	return std::atomic_load(&_published);
+}
@@ -1,12 +1,42 @@
+#include <atomic>
+#include <chrono>
 #include <future>
 #include <list>
 #include <thread>
 #include <mutex>
 #include <map>
+#include <memory>
+#include <optional>
+#include <vector>
 
 #include "pg_param.hpp"
 #include "pg_result.hpp"
 #include "pg_query.hpp"
+#include "pg_statement.hpp"
+#include "pg_prepared.hpp"
+#include "pg_admission.hpp"
+#include "pg_awaitable.hpp"
+#include "pg_callback.hpp"
+#include "pg_column.hpp"
+#include "pg_columns.hpp"
+#include "pg_completion_queue.hpp"
+#include "pg_copy_buffer.hpp"
+#include "pg_copy_encoder.hpp"
+#include "pg_copy_fd_sink.hpp"
+#include "pg_copy_sink.hpp"
+#include "pg_copy_writer.hpp"
+#include "pg_decoder.hpp"
+#include "pg_executor.hpp"
+#include "pg_connection_error.hpp"
+#include "pg_options.hpp"
+#include "pg_readiness.hpp"
+#include "pg_row.hpp"
+#include "pg_stats.hpp"
+#include "pg_stream.hpp"
+#include "pg_submit_queue.hpp"
+#include "pg_types.hpp"
+
+class pg_reactor;
 
 class async_pg {
 public:
@@ -15,37 +45,248 @@ public:
 	async_pg(std::map<std::string, std::string> params);
 	~async_pg();
 
-	void start(int n_connections);
+	// Connections are opened in the background and queries submitted meanwhile wait for them.
+	// The returned future is ready once options.ready_connections connections are up,
+	// and holds "stopping service" if the pool is stopped before that.
+	std::shared_future<void> start(int n_connections);
+	std::shared_future<void> start(const pg_pool_options& options);
 	void stop();
 
+	// Embedded mode, see pg_pool_options::embedded. fd() is an epoll descriptor that becomes readable
+	// when the pool has work, timeout() the milliseconds until run_once is due anyway, -1 for none.
+	// run_once waits up to timeout_ms for events and processes them. These, and start and stop,
+	// are called from the event loop thread; queries may be submitted from any thread.
+	// The start future only gets ready while run_once is called.
+	int fd() const;
+	int timeout();
+	void run_once(int timeout_ms = 0);
+
+	// With pg_format::binary the values of the results are sent in binary and decoded by pg_result::get
+	// without parsing, see pg_format.
+	// A query with a timeout fails with "query timeout" once it expires. It is not sent if it is still queued,
+	// otherwise it is cancelled on the server and its connection is reused when the cancellation completes.
+	// A pipelined query with other commands in flight behind it is not cancelled, which could hit one of them,
+	// it runs to completion and its results are dropped.
+	// A zero timeout means no deadline.
+	// If the connection is lost while the query is in flight, the future holds pg_connection_error,
+	// unless the query is idempotent: it is then sent again on another connection, see pg_pool_options::max_replays.
 	std::future<std::list<pg_result>> execute(
 		std::string&& sql,
-		std::list<pg_param>&& params = {});
+		std::list<pg_param>&& params = {},
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
 
 	std::future<std::list<pg_result>> execute(
 		const std::string& sql,
-		const std::list<pg_param>& params = {});
+		const std::list<pg_param>& params = {},
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
 
 	std::future<std::list<pg_result>> execute_prepared(
 		std::string&& name,
 		std::string&& sql,
-		std::list<pg_param>&& params = {});
+		std::list<pg_param>&& params = {},
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
 
 	std::future<std::list<pg_result>> execute_prepared(
 		const std::string& name,
 		const std::string& sql,
-		const std::list<pg_param>& params = {});
+		const std::list<pg_param>& params = {},
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
+
+	// Never blocks: returns nothing if the queue is full or the pool is shedding load,
+	// see pg_pool_options::queue_capacity and shed_target_ms.
+	std::optional<std::future<std::list<pg_result>>> try_execute(
+		const std::string& sql,
+		const std::list<pg_param>& params = {},
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
+
+	std::optional<std::future<std::list<pg_result>>> try_execute_prepared(
+		const pg_prepared& statement,
+		const std::list<pg_param>& params = {},
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
+
+	// Registers a statement prepared by every connection of the pool, including connections
+	// opened or reset later, before they take queries. Registering a name again with the same
+	// statement returns it, with another statement throws std::runtime_error.
+	pg_prepared prepare(
+		const std::string& name,
+		const std::string& sql,
+		const std::vector<Oid>& param_types = {});
+
+	std::future<std::list<pg_result>> execute_prepared(
+		const pg_prepared& statement,
+		std::list<pg_param>&& params = {},
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
+
+	std::future<std::list<pg_result>> execute_prepared(
+		const pg_prepared& statement,
+		const std::list<pg_param>& params,
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
+
+	// Completion by callback instead of a future: callback(error, results) is called once, with a null error
+	// on success, on the reactor thread or posted to executor if given. Callbacks run on the reactor thread
+	// must not block. No allocation besides the query itself, see pg_callback for the handler size.
+	void execute(
+		const std::string& sql,
+		const std::list<pg_param>& params,
+		pg_callback callback,
+		pg_executor* executor = nullptr,
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
+
+	void execute_prepared(
+		const pg_prepared& statement,
+		const std::list<pg_param>& params,
+		pg_callback callback,
+		pg_executor* executor = nullptr,
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
+
+	void execute_batch(
+		std::vector<pg_statement>&& statements,
+		bool transaction,
+		pg_callback callback,
+		pg_executor* executor = nullptr);
+
+	// Completion through a queue: the completion is pushed to queue with tag, see pg_completion_queue.
+	void execute(
+		const std::string& sql,
+		const std::list<pg_param>& params,
+		pg_completion_queue& queue,
+		void* tag,
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
+
+	void execute_prepared(
+		const pg_prepared& statement,
+		const std::list<pg_param>& params,
+		pg_completion_queue& queue,
+		void* tag,
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
+
+	void execute_batch(
+		std::vector<pg_statement>&& statements,
+		bool transaction,
+		pg_completion_queue& queue,
+		void* tag);
+
+	// Awaitable forms for C++20 coroutines, see pg_awaitable. The query is sent once awaited.
+	pg_awaitable query(
+		const std::string& sql,
+		const std::list<pg_param>& params = {},
+		pg_executor* executor = nullptr,
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
+
+	pg_awaitable query_prepared(
+		const pg_prepared& statement,
+		const std::list<pg_param>& params = {},
+		pg_executor* executor = nullptr,
+		std::chrono::milliseconds timeout = {},
+		bool idempotent = false,
+		pg_format format = pg_format::text);
+
+	pg_awaitable query_batch(
+		std::vector<pg_statement>&& statements,
+		bool transaction = false,
+		pg_executor* executor = nullptr);
+
+	// Rows delivered while the query runs instead of all at once, see pg_stream: up to capacity rows
+	// are buffered, the connection is not read meanwhile. The query waits for a connection with nothing
+	// in flight and nothing is pipelined behind it. Streamed queries are never replayed.
+	std::shared_ptr<pg_stream> stream(
+		const std::string& sql,
+		const std::list<pg_param>& params = {},
+		std::size_t capacity = 1024,
+		std::chrono::milliseconds timeout = {},
+		pg_format format = pg_format::text);
+
+	std::shared_ptr<pg_stream> stream_prepared(
+		const pg_prepared& statement,
+		const std::list<pg_param>& params = {},
+		std::size_t capacity = 1024,
+		std::chrono::milliseconds timeout = {},
+		pg_format format = pg_format::text);
+
+	// Bulk load with COPY ... FROM STDIN: sql is the COPY statement and its data is written through
+	// the returned writer, see pg_copy_writer, in text format or binary, see pg_copy_encoder.
+	// Up to capacity bytes are buffered. The copy takes a connection with nothing in flight
+	// and holds it until the data is finished. Copies are never replayed.
+	std::shared_ptr<pg_copy_writer> copy_in(
+		const std::string& sql,
+		std::size_t capacity = 1 << 20,
+		std::chrono::milliseconds timeout = {});
+
+	// Export with COPY ... TO STDOUT: sql is the COPY statement and its rows go to sink as they arrive,
+	// see pg_copy_sink, so memory stays the same whatever the size of the table. sink has to outlive
+	// the returned future, which holds the COPY result once sink.end was called.
+	// The copy takes a connection with nothing in flight. Copies are never replayed.
+	std::future<std::list<pg_result>> copy_out(
+		const std::string& sql,
+		pg_copy_sink& sink,
+		std::chrono::milliseconds timeout = {});
+
+	// Sends all statements to one connection in a single write, the future holds one result per statement.
+	// With transaction the batch runs in one implicit transaction and the first error aborts the rest.
+	std::future<std::list<pg_result>> execute_batch(
+		std::vector<pg_statement>&& statements,
+		bool transaction = false);
+
+	std::future<std::list<pg_result>> execute_batch(
+		const std::vector<pg_statement>& statements,
+		bool transaction = false);
+
+	pg_stats stats() const;
 
 private:
-	void process(int n_connections);
-	void cond_notify();
-	void cond_reset();
+	friend class pg_awaitable;
+
+	void admit(pg_query* query);
+	std::shared_ptr<pg_stream> admit_stream(pg_query* query, std::size_t capacity, std::chrono::milliseconds timeout, pg_format format);
+	bool try_admit();
+	void submit(pg_query* query);
+	void dispatch_pending();
 
 	bool _running;
-	std::thread _thr;
-	std::mutex _mtx;
-	std::list<pg_query> _queries;
+	bool _embedded;
+	std::mutex _mtx;			// serializes start/stop/prepare
+	using reactors = std::vector<std::unique_ptr<pg_reactor>>;
+	void publish(std::shared_ptr<const reactors> set);
+	std::shared_ptr<const reactors> snapshot() const;
+
+	// Reactors started and stopped under _mtx, replaced as a whole when their number or mode changes.
+	// Producers submit to the set published in _published, null until started and while the set is
+	// replaced, and keep it alive while they use it. Queries still queued on a replaced set are drained
+	// into _pending once its last user drops it.
+	std::shared_ptr<const reactors> _reactors;
+	std::shared_ptr<const reactors> _published;	// std::atomic_load and std::atomic_store only
+	std::atomic<std::size_t> _next_reactor;
+	pg_submit_queue _pending;	// submitted before start()
+	std::shared_ptr<const std::vector<pg_prepared>> _registry;	// copied on write, shared with the reactors
+	pg_admission _admission;
+	pg_readiness _readiness;
+	std::atomic<bool> _block_when_full;
+	std::atomic<uint64_t> _queries_rejected;
 	std::map<std::string, std::string> _connection_params;
-	int _notifiy_fd;
-	int _wait_fd;
 };
\ No newline at end of file
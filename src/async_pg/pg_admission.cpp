@@ -0,0 +1,74 @@
+#include "pg_admission.hpp"
+
+pg_admission::pg_admission() :
+	_size(0),
+	_capacity(0),
+	_overloaded(0),
+	_waiters(0),
+	_closed(false)
+{}
+
+void pg_admission::open(std::size_t capacity) {
+	std::lock_guard<std::mutex> lock(_mtx);
+	_capacity = capacity;
+	_closed = false;
+}
+
+void pg_admission::close() {
+	std::lock_guard<std::mutex> lock(_mtx);
+	_closed = true;
+	_cv.notify_all();
+}
+
+bool pg_admission::try_acquire() {
+	if (_closed.load()) {
+		return false;
+	}
+	std::size_t capacity = _capacity.load(std::memory_order_relaxed);
+	if (capacity == 0) {
+		_size.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	std::size_t size = _size.load(std::memory_order_relaxed);
+	while (size < capacity) {
+		if (_size.compare_exchange_weak(size, size + 1, std::memory_order_relaxed)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool pg_admission::acquire() {
+	if (try_acquire()) {
+		return true;
+	}
+
+	// release() notifies only when it sees a waiter, _waiters is published before the queue is checked again
+	// a place taken is kept even if the admission closes right after
+	std::unique_lock<std::mutex> lock(_mtx);
+	_waiters.fetch_add(1);
+	bool acquired = false;
+	_cv.wait(lock, [this, &acquired] { return _closed || (acquired = try_acquire()); });
+	_waiters.fetch_sub(1);
+	return acquired;
+}
+
+void pg_admission::readmit(std::size_t n) {
+	_size.fetch_add(n);
+}
+
+void pg_admission::release(std::size_t n) {
+	if (n == 0) {
+		return;
+	}
+	_size.fetch_sub(n);
+	if (_waiters.load() > 0) {
+		std::lock_guard<std::mutex> lock(_mtx);
+		_cv.notify_all();
+	}
+}
+
+void pg_admission::set_overloaded(bool overloaded) {
+	_overloaded.fetch_add(overloaded ? 1 : -1, std::memory_order_relaxed);
+}
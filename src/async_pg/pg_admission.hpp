@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+// Admission control shared by the pool and its reactors.
+// Bounds the number of queries submitted and not yet sent, pool-wide,
+// and carries the overload signal of the reactors that shed load.
+class pg_admission {
+public:
+	pg_admission(const pg_admission&) = delete;
+	pg_admission& operator=(const pg_admission&) = delete;
+
+	pg_admission();
+
+	// 0 is unbounded. Reopens admission closed by close().
+	void open(std::size_t capacity);
+	// wakes up blocked producers, acquire fails until the next open
+	void close();
+
+	// both fail once closed
+	bool try_acquire();
+	// blocks while the queue is full, false once closed
+	bool acquire();
+	bool closed() const { return _closed.load(); }
+	// n queries left the queue: sent, dropped or failed
+	void release(std::size_t n = 1);
+	// n queries taken back into the queue regardless of the capacity, see pg_reactor::replay
+	void readmit(std::size_t n);
+	std::size_t size() const { return _size.load(std::memory_order_relaxed); }
+
+	void set_overloaded(bool overloaded);
+	bool overloaded() const { return _overloaded.load(std::memory_order_relaxed) > 0; }
+
+private:
+	std::atomic<std::size_t> _size;
+	std::atomic<std::size_t> _capacity;
+	std::atomic<int> _overloaded;	// reactors currently shedding
+	std::atomic<int> _waiters;
+	std::atomic<bool> _closed;
+	std::mutex _mtx;
+	std::condition_variable _cv;
+};
@@ -0,0 +1,22 @@
+#include "pg_awaitable.hpp"
+#include <utility>
+#include "async_pg.hpp"
+
+pg_awaitable::pg_awaitable(async_pg& pool, std::unique_ptr<pg_query> query, pg_executor* executor) :
+	_pool(&pool),
+	_query(std::move(query)),
+	_executor(executor)
+{}
+
+std::list<pg_result> pg_awaitable::await_resume() {
+	if (_error) {
+		std::rethrow_exception(_error);
+	}
+	return std::move(_results);
+}
+
+void pg_awaitable::submit(pg_callback&& callback) {
+	pg_query* query = _query.release();
+	query->set_callback(std::move(callback), _executor);
+	_pool->admit(query);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <exception>
+#include <list>
+#include <memory>
+#include "pg_callback.hpp"
+#include "pg_executor.hpp"
+#include "pg_query.hpp"
+#include "pg_result.hpp"
+
+class async_pg;
+
+// Awaitable query for C++20 coroutines, returned by async_pg::query:
+//	std::list<pg_result> results = co_await pg.query("SELECT ...", params);
+// The query is submitted when the coroutine suspends and the coroutine is resumed on the reactor thread,
+// or by the executor given to async_pg::query. Errors are rethrown by co_await.
+// Suspending allocates nothing: the coroutine handle is kept in the inline storage of the query callback.
+// Nothing here requires C++20 itself, the library builds as C++17 and only coroutine callers need C++20.
+class pg_awaitable {
+public:
+	pg_awaitable(async_pg& pool, std::unique_ptr<pg_query> query, pg_executor* executor);
+
+	pg_awaitable(pg_awaitable&&) = default;
+	pg_awaitable(const pg_awaitable&) = delete;
+	pg_awaitable& operator=(const pg_awaitable&) = delete;
+
+	// without a query, e.g. an empty batch, there is nothing to wait for
+	bool await_ready() const { return !_query; }
+
+	// the query might complete, and the coroutine resume, before submit returns
+	template <typename Handle>
+	void await_suspend(Handle handle) {
+		submit([this, handle](std::exception_ptr error, std::list<pg_result>&& results) mutable {
+			_error = error;
+			_results = std::move(results);
+			handle.resume();
+		});
+	}
+
+	std::list<pg_result> await_resume();
+
+private:
+	void submit(pg_callback&& callback);
+
+	async_pg* _pool;
+	std::unique_ptr<pg_query> _query;
+	pg_executor* _executor;
+	std::exception_ptr _error;
+	std::list<pg_result> _results;
+};
@@ -0,0 +1,38 @@
+#include "pg_callback.hpp"
+
+pg_callback::pg_callback(pg_callback&& o) noexcept {
+	if (o._ops) {
+		o._ops->move(o._storage, _storage);
+		_ops = o._ops;
+		o._ops = nullptr;
+	}
+}
+
+pg_callback& pg_callback::operator=(pg_callback&& o) noexcept {
+	if (this != &o) {
+		reset();
+		if (o._ops) {
+			o._ops->move(o._storage, _storage);
+			_ops = o._ops;
+			o._ops = nullptr;
+		}
+	}
+	return *this;
+}
+
+pg_callback::~pg_callback() {
+	reset();
+}
+
+void pg_callback::operator()(std::exception_ptr error, std::list<pg_result>&& results) {
+	if (_ops) {
+		_ops->invoke(_storage, error, std::move(results));
+	}
+}
+
+void pg_callback::reset() {
+	if (_ops) {
+		_ops->destroy(_storage);
+		_ops = nullptr;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <list>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "pg_result.hpp"
+
+// Completion handler of a query: called once with either an error or the results.
+// The handler is stored inline, so a query completed by callback allocates nothing besides itself.
+// Handlers larger than capacity do not compile, capture by reference or pointer instead.
+class pg_callback {
+public:
+	static constexpr std::size_t capacity = 64;
+
+	// empty; there is no default constructor, so that {} keeps meaning a zero timeout in async_pg overloads
+	pg_callback(std::nullptr_t) {}
+
+	template <typename F, typename = typename std::enable_if<
+		!std::is_same<typename std::decay<F>::type, pg_callback>::value
+		&& std::is_invocable<typename std::decay<F>::type&, std::exception_ptr, std::list<pg_result>&&>::value>::type>
+	pg_callback(F&& f) {
+		using handler = typename std::decay<F>::type;
+		static_assert(sizeof(handler) <= capacity, "pg_callback handler does not fit the inline storage");
+		static_assert(alignof(handler) <= alignof(std::max_align_t), "pg_callback handler is over-aligned");
+		new (_storage) handler(std::forward<F>(f));
+		_ops = &ops_of<handler>::table;
+	}
+
+	pg_callback(pg_callback&& o) noexcept;
+	pg_callback& operator=(pg_callback&& o) noexcept;
+	~pg_callback();
+
+	pg_callback(const pg_callback&) = delete;
+	pg_callback& operator=(const pg_callback&) = delete;
+
+	explicit operator bool() const { return _ops != nullptr; }
+	void operator()(std::exception_ptr error, std::list<pg_result>&& results);
+
+private:
+	struct ops {
+		void (*invoke)(void* f, std::exception_ptr error, std::list<pg_result>&& results);
+		void (*move)(void* from, void* to);	// move-constructs into to and destroys from
+		void (*destroy)(void* f);
+	};
+
+	template <typename F>
+	struct ops_of {
+		static void invoke(void* f, std::exception_ptr error, std::list<pg_result>&& results) {
+			(*static_cast<F*>(f))(error, std::move(results));
+		}
+		static void move(void* from, void* to) {
+			new (to) F(std::move(*static_cast<F*>(from)));
+			static_cast<F*>(from)->~F();
+		}
+		static void destroy(void* f) {
+			static_cast<F*>(f)->~F();
+		}
+		static constexpr ops table{ &invoke, &move, &destroy };
+	};
+
+	void reset();
+
+	alignas(std::max_align_t) unsigned char _storage[capacity];
+	const ops* _ops = nullptr;
+};
@@ -0,0 +1,55 @@
+#include "pg_canceller.hpp"
+#include "pg_log.hpp"
+
+pg_canceller::pg_canceller() :
+	_stopping(false)
+{}
+
+pg_canceller::~pg_canceller() {
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_stopping = true;
+	}
+	_cv.notify_one();
+	if (_thr.joinable()) {
+		_thr.join();
+	}
+	for (PGcancel* c : _requests) {
+		PQfreeCancel(c);
+	}
+}
+
+void pg_canceller::post(PGcancel* cancel) {
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_requests.push_back(cancel);
+		if (!_thr.joinable()) {
+			_thr = std::thread(&pg_canceller::process, this);
+		}
+	}
+	_cv.notify_one();
+}
+
+void pg_canceller::process() {
+	std::unique_lock<std::mutex> lock(_mtx);
+	while (true) {
+		_cv.wait(lock, [this] { return _stopping || _requests.size(); });
+		if (_stopping) {
+			break;
+		}
+
+		PGcancel* cancel = _requests.front();
+		_requests.pop_front();
+		lock.unlock();
+
+		//	PQcancel can safely be invoked from a thread that is separate from the one manipulating the PGconn object.
+		//	The return value is 1 if the cancel request was successfully dispatched and 0 if not.
+		char err[256];
+		if (PQcancel(cancel, err, sizeof(err)) == 0) {
+			log_error("PQcancel -> %s", err);
+		}
+		PQfreeCancel(cancel);
+
+		lock.lock();
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "libpq-fe.h"
+
+// Sends cancel requests on its own thread, so the reactor does not block while
+// PQcancel opens a connection to the server. The thread starts with the first request.
+class pg_canceller {
+public:
+	pg_canceller(const pg_canceller&) = delete;
+	pg_canceller& operator=(const pg_canceller&) = delete;
+
+	pg_canceller();
+	~pg_canceller();
+
+	// takes ownership of cancel, obtained with PQgetCancel
+	void post(PGcancel* cancel);
+
+private:
+	void process();
+
+	std::mutex _mtx;
+	std::condition_variable _cv;
+	std::deque<PGcancel*> _requests;
+	bool _stopping;
+	std::thread _thr;
+};
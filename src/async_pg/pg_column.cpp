@@ -0,0 +1,297 @@
+#include "pg_column.hpp"
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include "pg_decoder.hpp"
+#include "pg_result.hpp"
+
+namespace {
+
+	pg_column_type column_type(Oid oid) {
+		switch (oid) {
+		case pg_bool_oid:
+			return pg_column_type::boolean;
+		case pg_int2_oid:
+			return pg_column_type::int16;
+		case pg_int4_oid:
+			return pg_column_type::int32;
+		case pg_int8_oid:
+			return pg_column_type::int64;
+		case pg_float4_oid:
+			return pg_column_type::float32;
+		case pg_float8_oid:
+			return pg_column_type::float64;
+		case pg_timestamp_oid:
+		case pg_timestamptz_oid:
+			return pg_column_type::timestamp;
+		default:
+			return pg_column_type::string;
+		}
+	}
+
+	std::size_t value_size(pg_column_type type) {
+		switch (type) {
+		case pg_column_type::boolean:
+			return 1;
+		case pg_column_type::int16:
+			return 2;
+		case pg_column_type::int32:
+		case pg_column_type::float32:
+			return 4;
+		case pg_column_type::int64:
+		case pg_column_type::float64:
+		case pg_column_type::timestamp:
+			return 8;
+		default:
+			return 0;
+		}
+	}
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	// eight ASCII digits, the first one in the lowest byte, to their value in three multiplications
+	uint64_t swar8(uint64_t v) {
+		v = (v & 0x0F0F0F0F0F0F0F0F) * 2561 >> 8;
+		v = (v & 0x00FF00FF00FF00FF) * 6553601 >> 16;
+		return (v & 0x0000FFFF0000FFFF) * 42949672960001 >> 32;
+	}
+
+	// every byte is '0' to '9'
+	bool digits8(uint64_t v) {
+		return ((v & 0xF0F0F0F0F0F0F0F0) | (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+	}
+
+	// Decimal integer of up to 19 digits. The digits are right aligned on '0' bytes and converted
+	// eight at a time, with no branch per digit.
+	bool parse_decimal(const char* p, int length, int64_t& n) {
+		bool negative = length > 0 && p[0] == '-';
+		p += negative;
+		length -= negative;
+		if (length <= 0 || length > 19) {
+			return false;
+		}
+		uint64_t value;
+		if (length <= 8) {
+			uint64_t w = 0x3030303030303030;
+			std::memcpy((char*)&w + 8 - length, p, length);
+			if (!digits8(w)) {
+				return false;
+			}
+			value = swar8(w);
+		}
+		else {
+			char b[24];
+			std::memset(b, '0', sizeof(b));
+			std::memcpy(b + sizeof(b) - length, p, length);
+			uint64_t w[3];
+			std::memcpy(w, b, sizeof(b));
+			if (!(digits8(w[0]) & digits8(w[1]) & digits8(w[2]))) {
+				return false;
+			}
+			value = swar8(w[0]) * 10000000000000000 + swar8(w[1]) * 100000000 + swar8(w[2]);
+			if (value > (uint64_t)std::numeric_limits<int64_t>::max() + negative) {
+				return false;
+			}
+		}
+		n = negative ? (int64_t)(0 - value) : (int64_t)value;
+		return true;
+	}
+#else
+	bool parse_decimal(const char* p, int length, int64_t& n) {
+		auto r = std::from_chars(p, p + length, n);
+		return r.ec == std::errc() && r.ptr == p + length;
+	}
+#endif
+
+	// Conversion kernels of a column, one loop per type. Null entries, a null value pointer, become 0.
+	template <typename T>
+	void convert_ints(const char* const* values, const int* lengths, T* out, std::size_t n, bool binary, const char* type) {
+		for (std::size_t i = 0; i < n; ++i) {
+			const char* v = values[i];
+			if (!v) {
+				out[i] = 0;
+			}
+			else if (binary) {
+				out[i] = sizeof(T) == 2 ? (T)pg_be16(v) : sizeof(T) == 4 ? (T)pg_be32(v) : (T)pg_be64(v);
+			}
+			else {
+				int64_t x;
+				if (!parse_decimal(v, lengths[i], x) || x < std::numeric_limits<T>::min() || x > std::numeric_limits<T>::max()) {
+					pg_invalid_value(type, v);
+				}
+				out[i] = (T)x;
+			}
+		}
+	}
+
+	template <typename T>
+	void convert_floats(const char* const* values, const int* lengths, T* out, std::size_t n, bool binary, const char* type) {
+		for (std::size_t i = 0; i < n; ++i) {
+			const char* v = values[i];
+			if (!v) {
+				out[i] = 0;
+			}
+			else if (binary) {
+				if (sizeof(T) == 4) {
+					uint32_t bits = pg_be32(v);
+					std::memcpy(&out[i], &bits, sizeof(T));
+				}
+				else {
+					uint64_t bits = pg_be64(v);
+					std::memcpy(&out[i], &bits, sizeof(T));
+				}
+			}
+			else {
+				// NaN, Infinity and -Infinity included
+				auto r = std::from_chars(v, v + lengths[i], out[i]);
+				if (r.ec != std::errc() || r.ptr != v + lengths[i]) {
+					pg_invalid_value(type, v);
+				}
+			}
+		}
+	}
+
+	void convert_bools(const char* const* values, uint8_t* out, std::size_t n, bool binary) {
+		for (std::size_t i = 0; i < n; ++i) {
+			const char* v = values[i];
+			out[i] = v && (binary ? v[0] != 0 : v[0] == 't');
+		}
+	}
+
+	void convert_timestamps(const char* const* values, const int* lengths, int64_t* out, std::size_t n, bool binary) {
+		for (std::size_t i = 0; i < n; ++i) {
+			out[i] = values[i] ? pg_decode_timestamp(values[i], lengths[i], binary) : 0;
+		}
+	}
+
+}
+
+pg_column::pg_column(std::string name, Oid oid) :
+	_name(std::move(name)),
+	_oid(oid),
+	_type(column_type(oid))
+{
+	if (_type == pg_column_type::string) {
+		_offsets.push_back(0);
+	}
+}
+
+void pg_column::begin(std::size_t n, std::size_t chunk, bool binary) {
+
+	_value_ptrs.resize(chunk);
+	_lengths.resize(chunk);
+	_binary = binary;
+	_appended_nulls = 0;
+
+	// the bits of a failed append are cleared first
+	_validity.resize((_size + n + 7) / 8);
+	if (_size & 7) {
+		_validity[_size >> 3] &= (uint8_t)((1 << (_size & 7)) - 1);
+	}
+	std::memset(_validity.data() + (_size + 7) / 8, 0, _validity.size() - (_size + 7) / 8);
+
+	if (_type == pg_column_type::string) {
+		_offsets.reserve(_size + n + 1);
+	}
+	else {
+		_values.resize((_size + n) * value_size(_type));
+	}
+}
+
+void pg_column::convert(std::size_t at, std::size_t n) {
+
+	const char* const* values = _value_ptrs.data();
+	const int* lengths = _lengths.data();
+	for (std::size_t i = 0; i < n; ++i) {
+		_appended_nulls += values[i] == nullptr;
+	}
+
+	uint8_t* out = _values.data() + at * value_size(_type);
+	switch (_type) {
+	case pg_column_type::boolean:
+		convert_bools(values, out, n, _binary);
+		break;
+	case pg_column_type::int16:
+		convert_ints(values, lengths, (int16_t*)out, n, _binary, "int16");
+		break;
+	case pg_column_type::int32:
+		convert_ints(values, lengths, (int32_t*)out, n, _binary, "int32");
+		break;
+	case pg_column_type::int64:
+		convert_ints(values, lengths, (int64_t*)out, n, _binary, "int64");
+		break;
+	case pg_column_type::float32:
+		convert_floats(values, lengths, (float*)out, n, _binary, "float");
+		break;
+	case pg_column_type::float64:
+		convert_floats(values, lengths, (double*)out, n, _binary, "double");
+		break;
+	case pg_column_type::timestamp:
+		convert_timestamps(values, lengths, (int64_t*)out, n, _binary);
+		break;
+	case pg_column_type::string:
+		for (std::size_t i = 0; i < n; ++i) {
+			if (values[i]) {
+				_data.append(values[i], lengths[i]);
+			}
+			// 32 bit offsets as Arrow strings, not large strings
+			if (_data.size() > (std::size_t)std::numeric_limits<int32_t>::max()) {
+				throw std::runtime_error("column " + _name + " holds more than 2 GB of strings");
+			}
+			_offsets.push_back((int32_t)_data.size());
+		}
+		break;
+	}
+}
+
+void pg_column::commit(std::size_t n) {
+	_size += n;
+	_null_count += _appended_nulls;
+	_appended_nulls = 0;
+}
+
+void pg_column::truncate() {
+	_appended_nulls = 0;
+	if (_type == pg_column_type::string) {
+		_offsets.resize(_size + 1);
+		_data.resize(_offsets[_size]);
+	}
+}
+
+const void* pg_column::raw(pg_column_type type) const {
+	if (_type != type) {
+		throw std::runtime_error("column " + _name + " does not hold values of this type");
+	}
+	return _values.data();
+}
+
+template <>
+const uint8_t* pg_column::values<uint8_t>() const {
+	return (const uint8_t*)raw(pg_column_type::boolean);
+}
+
+template <>
+const int16_t* pg_column::values<int16_t>() const {
+	return (const int16_t*)raw(pg_column_type::int16);
+}
+
+template <>
+const int32_t* pg_column::values<int32_t>() const {
+	return (const int32_t*)raw(pg_column_type::int32);
+}
+
+// int64 and timestamp columns
+template <>
+const int64_t* pg_column::values<int64_t>() const {
+	return (const int64_t*)raw(_type == pg_column_type::timestamp ? pg_column_type::timestamp : pg_column_type::int64);
+}
+
+template <>
+const float* pg_column::values<float>() const {
+	return (const float*)raw(pg_column_type::float32);
+}
+
+template <>
+const double* pg_column::values<double>() const {
+	return (const double*)raw(pg_column_type::float64);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "libpq-fe.h"
+
+class pg_result;
+
+// Type of the values of a pg_column, after the type oid of the result column
+enum class pg_column_type {
+	boolean,	// uint8_t, 0 or 1
+	int16,		// int16_t
+	int32,		// int32_t
+	int64,		// int64_t
+	float32,	// float
+	float64,	// double
+	timestamp,	// int64_t microseconds since the Unix epoch, timestamp and timestamptz
+	string		// any other type: the text form, or the binary form of binary results
+};
+
+// One column of pg_columns in the layout of Arrow arrays: fixed size values are contiguous,
+// strings are an offsets array into a single data buffer, and nulls are a validity bitmap.
+// Null entries hold 0 or an empty string, loops summing a column need not look at the bitmap.
+class pg_column {
+public:
+	pg_column(std::string name, Oid oid);
+
+	const std::string& name() const { return _name; }
+	Oid oid() const { return _oid; }
+	pg_column_type type() const { return _type; }
+	std::size_t size() const { return _size; }
+	std::size_t null_count() const { return _null_count; }
+
+	// bit i, least significant bit first, is set for a value that is not null; nullptr if no value is null
+	const uint8_t* validity() const { return _null_count ? _validity.data() : nullptr; }
+	bool is_null(std::size_t i) const { return !(_validity[i >> 3] & (1 << (i & 7))); }
+
+	// Values of a fixed size column, T as given by pg_column_type; throws std::runtime_error for another type.
+	template <typename T>
+	const T* values() const;
+
+	// string columns: value i is data()[offsets()[i], offsets()[i + 1])
+	const int32_t* offsets() const { return _offsets.data(); }
+	const char* data() const { return _data.data(); }
+	std::string_view string(std::size_t i) const { return std::string_view(_data.data() + _offsets[i], _offsets[i + 1] - _offsets[i]); }
+
+private:
+	friend class pg_columns;
+
+	// An append of n rows: begin sizes the buffers, pg_columns gathers the values of a chunk of rows
+	// into _value_ptrs and _lengths, convert runs the kernel of the column over them, at the index of
+	// the first row of the chunk, and commit makes the rows visible. truncate drops a failed append.
+	void begin(std::size_t n, std::size_t chunk, bool binary);
+	void convert(std::size_t at, std::size_t n);
+	void commit(std::size_t n);
+	void truncate();
+	const void* raw(pg_column_type type) const;
+
+	std::string _name;
+	Oid _oid;
+	pg_column_type _type;
+	std::size_t _size = 0;
+	std::size_t _null_count = 0;
+	std::vector<uint8_t> _values;	// fixed size values, aligned by the allocator
+	std::vector<uint8_t> _validity;
+	std::vector<int32_t> _offsets;
+	std::string _data;
+
+	// chunk of the result being appended, null values have a null pointer; kept to append without allocating
+	std::vector<const char*> _value_ptrs;
+	std::vector<int> _lengths;
+	bool _binary = false;
+	std::size_t _appended_nulls = 0;
+};
+
+template <> const uint8_t* pg_column::values<uint8_t>() const;
+template <> const int16_t* pg_column::values<int16_t>() const;
+template <> const int32_t* pg_column::values<int32_t>() const;
+template <> const int64_t* pg_column::values<int64_t>() const;
+template <> const float* pg_column::values<float>() const;
+template <> const double* pg_column::values<double>() const;
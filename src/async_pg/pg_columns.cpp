@@ -0,0 +1,101 @@
+#include "pg_columns.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+	// rows gathered at once, their values and lengths stay in the cache until converted
+	const std::size_t chunk_rows = 1024;
+
+}
+
+pg_columns::pg_columns(const pg_result& result) {
+	append(result);
+}
+
+void pg_columns::append(const pg_result& result) {
+
+	int n_cols = result.cols_count();
+	if (n_cols == 0) {
+		return;
+	}
+
+	if (_columns.empty()) {
+		_columns.reserve(n_cols);
+		for (int c = 0; c < n_cols; ++c) {
+			_columns.emplace_back(result.col_name(c), result.col_oid_number(c));
+		}
+	}
+	else if ((std::size_t)n_cols != _columns.size()) {
+		throw std::runtime_error("result of " + std::to_string(n_cols) + " columns appended to " + std::to_string(_columns.size()) + " columns");
+	}
+	else {
+		for (int c = 0; c < n_cols; ++c) {
+			if (result.col_oid_number(c) != _columns[c].oid()) {
+				throw std::runtime_error(std::string("column ") + result.col_name(c) + " of type oid " + std::to_string(result.col_oid_number(c))
+					+ " appended to a column of type oid " + std::to_string(_columns[c].oid()));
+			}
+		}
+	}
+
+	// Rows are gathered a chunk at a time, all columns in one pass over the rows of the result,
+	// then every column converts its part of the chunk while it is in the cache.
+	const PGresult* res = result._res;
+	std::size_t n = result.rows_count();
+	std::size_t chunk = std::min(n, chunk_rows);
+	for (int c = 0; c < n_cols; ++c) {
+		_columns[c].begin(n, chunk, result.is_binary(c));
+	}
+
+	// a value that fails to convert leaves the columns as they were
+	try {
+		for (std::size_t r0 = 0; r0 < n; r0 += chunk) {
+			std::size_t m = std::min(chunk, n - r0);
+			for (std::size_t k = 0; k < m; ++k) {
+				int r = (int)(r0 + k);
+				std::size_t i = _rows + r0 + k;
+				for (int c = 0; c < n_cols; ++c) {
+					pg_column& col = _columns[c];
+					if (PQgetisnull(res, r, c)) {
+						col._value_ptrs[k] = nullptr;
+						col._lengths[k] = 0;
+					}
+					else {
+						col._validity[i >> 3] |= (uint8_t)(1 << (i & 7));
+						col._value_ptrs[k] = PQgetvalue(res, r, c);
+						col._lengths[k] = PQgetlength(res, r, c);
+					}
+				}
+			}
+			for (auto& col : _columns) {
+				col.convert(_rows + r0, m);
+			}
+		}
+	}
+	catch (...) {
+		for (auto& col : _columns) {
+			col.truncate();
+		}
+		throw;
+	}
+
+	for (auto& col : _columns) {
+		col.commit(n);
+	}
+	_rows += n;
+}
+
+void pg_columns::append(const std::list<pg_result>& results) {
+	for (auto& r : results) {
+		append(r);
+	}
+}
+
+const pg_column& pg_columns::column(const std::string& name) const {
+	for (auto& c : _columns) {
+		if (c.name() == name) {
+			return c;
+		}
+	}
+	throw std::runtime_error("no column " + name);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <vector>
+#include "pg_column.hpp"
+#include "pg_result.hpp"
+
+// Result converted to columns, see pg_column: every column is a contiguous typed buffer with a validity
+// bitmap, so aggregations run over plain arrays instead of calling libpq for every value.
+// Results are converted a column at a time, text integers by a kernel converting eight digits at once,
+// binary values by a byte swap. Appending the batches of a stream builds the columns of a result
+// too large to hold at once:
+//
+//	pg_columns columns;
+//	std::list<pg_result> batch;
+//	while (stream->next_batch(batch, 1024)) {
+//		columns.append(batch);
+//		batch.clear();
+//	}
+//	const int64_t* amounts = columns.column("amount").values<int64_t>();
+class pg_columns {
+public:
+	pg_columns() {}
+	explicit pg_columns(const pg_result& result);
+
+	// Appends the rows of result, which has the columns of the first result appended.
+	// Results without columns, e.g. commands, are skipped. Throws std::runtime_error for another
+	// set of columns or a value that cannot be converted, the columns are then left as they were.
+	void append(const pg_result& result);
+	void append(const std::list<pg_result>& results);
+
+	std::size_t rows_count() const { return _rows; }
+	std::size_t cols_count() const { return _columns.size(); }
+	const pg_column& operator[](std::size_t col) const { return _columns[col]; }
+
+	// throws std::runtime_error if there is no column name
+	const pg_column& column(const std::string& name) const;
+
+private:
+	std::vector<pg_column> _columns;
+	std::size_t _rows = 0;
+};
@@ -0,0 +1,22 @@
+#include "pg_completion.hpp"
+#include <utility>
+#include "pg_log.hpp"
+
+pg_completion::pg_completion(pg_callback&& callback, std::exception_ptr error, std::list<pg_result>&& results) :
+	_callback(std::move(callback)),
+	_error(error),
+	_results(std::move(results))
+{}
+
+void pg_completion::run() {
+	// an exception escaping a callback must not take the executor thread down
+	try {
+		_callback(_error, std::move(_results));
+	}
+	catch (const std::exception& e) {
+		log_error("query callback threw: %s", e.what());
+	}
+	catch (...) {
+		log_error("query callback threw");
+	}
+}
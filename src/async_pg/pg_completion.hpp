@@ -0,0 +1,23 @@
+#pragma once
+
+#include <exception>
+#include <list>
+#include "pg_callback.hpp"
+#include "pg_result.hpp"
+
+// A completed query handed to a pg_executor: the callback with its error or results.
+// run() calls the callback, on whatever thread the executor runs it.
+class pg_completion {
+public:
+	pg_completion(pg_callback&& callback, std::exception_ptr error, std::list<pg_result>&& results);
+
+	pg_completion(pg_completion&&) = default;
+	pg_completion& operator=(pg_completion&&) = default;
+
+	void run();
+
+private:
+	pg_callback _callback;
+	std::exception_ptr _error;
+	std::list<pg_result> _results;
+};
@@ -0,0 +1,118 @@
+#include "pg_completion_queue.hpp"
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+namespace {
+	thread_local bool t_hold = false;
+	thread_local std::vector<pg_completion_queue*> t_held;
+}
+
+pg_completion_queue::pg_completion_queue() :
+	_waiters(0),
+	_shutdown(false),
+	_held(false),
+	_waking(0)
+{}
+
+pg_completion_queue::~pg_completion_queue() {
+	// A wakeup held by this thread, the queue being destroyed by a callback on the reactor thread
+	// or inside run_once, is dropped: nobody waits on a queue being destroyed.
+	auto held = std::find(t_held.begin(), t_held.end(), this);
+	if (held != t_held.end()) {
+		t_held.erase(held);
+		std::lock_guard<std::mutex> lock(_mtx);
+		_held = false;
+	}
+
+	// a worker may take the events before the reactor that pushed them releases the wakeup
+	std::unique_lock<std::mutex> lock(_mtx);
+	while (_held || _waking.load()) {
+		lock.unlock();
+		std::this_thread::yield();
+		lock.lock();
+	}
+}
+
+void pg_completion_queue::push(void* tag, std::exception_ptr error, std::list<pg_result>&& results) {
+	bool wake;
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		// events pushed while the first one is not taken yet join its wakeup
+		wake = _events.empty() && _waiters > 0;
+		_events.push_back(event{ tag, error, std::move(results) });
+		if (wake && t_hold) {
+			if (!_held) {
+				_held = true;
+				t_held.push_back(this);
+			}
+			return;
+		}
+	}
+	if (wake) {
+		_cv.notify_one();
+	}
+}
+
+std::size_t pg_completion_queue::next_batch(std::vector<event>& out, std::size_t max, std::chrono::milliseconds timeout) {
+
+	std::unique_lock<std::mutex> lock(_mtx);
+	if (_events.empty() && !_shutdown) {
+		++_waiters;
+		_cv.wait_for(lock, timeout, [this] { return !_events.empty() || _shutdown; });
+		--_waiters;
+	}
+
+	std::size_t n = std::min(max, _events.size());
+	for (std::size_t i = 0; i < n; ++i) {
+		out.push_back(std::move(_events.front()));
+		_events.pop_front();
+	}
+
+	// the rest of the batch goes to the next waiting worker
+	bool wake = _events.size() && _waiters > 0;
+	lock.unlock();
+	if (wake) {
+		_cv.notify_one();
+	}
+	return n;
+}
+
+void pg_completion_queue::shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_shutdown = true;
+	}
+	_cv.notify_all();
+}
+
+void pg_completion_queue::hold_wakeups(bool hold) {
+	if (!hold) {
+		flush_wakeups();
+	}
+	t_hold = hold;
+}
+
+void pg_completion_queue::flush_wakeups() {
+	for (pg_completion_queue* q : t_held) {
+		q->wake();
+	}
+	t_held.clear();
+}
+
+void pg_completion_queue::wake() {
+	// cleared under the lock, so that a push after this point notifies by itself,
+	// and notified outside of it, so that the woken worker does not block on the lock again
+	_waking.fetch_add(1);
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_held = false;
+	}
+	_cv.notify_one();
+	_waking.fetch_sub(1);
+}
+
+std::size_t pg_completion_queue::size() {
+	std::lock_guard<std::mutex> lock(_mtx);
+	return _events.size();
+}
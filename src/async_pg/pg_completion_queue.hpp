@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <list>
+#include <mutex>
+#include <vector>
+#include "pg_result.hpp"
+
+// Completions of many queries collected in one place, see async_pg::execute with a queue and a tag.
+// Reactors push tagged events, worker threads take them in batches with next_batch:
+// a waiting worker is woken up once per batch instead of once per query, and waiting for
+// any of the queries is next_batch with max 1, for all of them counting the tags back.
+class pg_completion_queue {
+public:
+	struct event {
+		void* tag;
+		std::exception_ptr error;	// null on success
+		std::list<pg_result> results;
+	};
+
+	pg_completion_queue(const pg_completion_queue&) = delete;
+	pg_completion_queue& operator=(const pg_completion_queue&) = delete;
+
+	pg_completion_queue();
+	~pg_completion_queue();
+
+	void push(void* tag, std::exception_ptr error, std::list<pg_result>&& results);
+
+	// Waits up to timeout for an event, then appends up to max events to out.
+	// Returns the number appended, 0 on timeout or once shut down and drained.
+	std::size_t next_batch(std::vector<event>& out, std::size_t max, std::chrono::milliseconds timeout);
+
+	// next_batch stops waiting, events already queued are still returned
+	void shutdown();
+
+	std::size_t size();
+
+	// Wakeups of queues pushed to by the calling thread are held until flush_wakeups.
+	// Reactors hold them for a loop iteration, so that its completions wake a worker once.
+	static void hold_wakeups(bool hold);
+	static void flush_wakeups();
+
+private:
+	void wake();
+
+	std::mutex _mtx;
+	std::condition_variable _cv;
+	std::deque<event> _events;
+	int _waiters;
+	bool _shutdown;
+	bool _held;		// in the held wakeups of a reactor thread, covers every push until wake
+	std::atomic<int> _waking;	// wakes notifying after _held was cleared
+};
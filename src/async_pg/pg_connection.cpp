@@ -1,14 +1,23 @@
 #include "pg_connection.hpp"
 
 
-pg_connection::pg_connection(int id) :
+pg_connection::pg_connection(int id, int pipeline_depth) :
 	_conn(nullptr),
 	_async_state(async_state_t::connection_failed),
 	_id(id),
-	_need_flush(false)
+	_pipeline_depth(pipeline_depth),
+	_in_flight(0),
+	_need_flush(false),
+	_copy_in(false),
+	_copy_out(false),
+	_copy_row(nullptr)
 {}
 
 pg_connection::~pg_connection() {
+	if (_copy_row) {
+		PQfreemem(_copy_row);
+		_copy_row = nullptr;
+	}
 	if (_conn) {
 		PQfinish(_conn);
 		_conn = nullptr;
@@ -73,12 +82,27 @@ bool pg_connection::start_reset() {
 	return true;
 }
 
+void pg_connection::close() {
+	if (_conn) {
+		PQfinish(_conn);
+		_conn = nullptr;
+	}
+	_prepared_statements.clear();
+	_partial.clear();
+	_commands.clear();
+	_in_flight = 0;
+	_need_flush = false;
+	_copy_in = false;
+	_copy_out = false;
+	_last_error = "connection closed";
+	_async_state = async_state_t::connection_failed;
+}
+
 PostgresPollingStatusType pg_connection::connectPoll() {
 	PostgresPollingStatusType s = PQconnectPoll(_conn);
 	if (_async_state == async_state_t::connecting) {
 		if (s == PostgresPollingStatusType::PGRES_POLLING_OK) {
-			_async_state = async_state_t::idle;
-			_prepared_statements.clear();
+			connected();
 		}
 		else if (s == PostgresPollingStatusType::PGRES_POLLING_FAILED) {
 			_async_state = async_state_t::connection_failed;
@@ -98,8 +122,7 @@ PostgresPollingStatusType pg_connection::resetPoll() {
 	PostgresPollingStatusType s = PQresetPoll(_conn);
 	if (_async_state == async_state_t::resetting) {
 		if (s == PostgresPollingStatusType::PGRES_POLLING_OK) {
-			_async_state = async_state_t::idle;
-			_prepared_statements.clear();
+			connected();
 		}
 		else if (s == PostgresPollingStatusType::PGRES_POLLING_FAILED) {
 			_async_state = async_state_t::connection_abort;
@@ -116,9 +139,9 @@ PostgresPollingStatusType pg_connection::resetPoll() {
 }
 
 
-bool pg_connection::start_send_query(const std::string& sql, const std::list<pg_param>& params) {
+bool pg_connection::start_send_query(const std::string& sql, const std::list<pg_param>& params, bool single_row, pg_format format) {
 
-	if (_async_state != async_state_t::idle) {
+	if (!can_send()) {
 		return false;
 	}
 
@@ -127,46 +150,192 @@ bool pg_connection::start_send_query(const std::string& sql, const std::list<pg_
 		return false;
 	}
 
-	if (params.empty()) {
+	// the simple query protocol is not available in pipeline mode and returns text only
+	if (params.empty() && !pipelined() && format == pg_format::text) {
 		if (PQsendQuery(_conn, sql.c_str()) == 0) {
 			_last_error = PQerrorMessage(_conn);
 			return false;
 		}
 	}
-	else {
-		int n_params = (int) params.size();
-		char** values = new char* [n_params];
-		int* lengths = new int[n_params];
-		int* formats = new int[n_params];
-		int i = 0;
-		for (auto& p : params) {
-			values[i] = (char*)p.data();
-			lengths[i] = (int)p.size();
-			formats[i] = (int)p.is_binary();
-			++i;
-		}
+	else if (!send_query_params(sql, params, format)) {
+		return false;
+	}
+
+	if (single_row) {
+		single_row_mode();
+	}
+	return sent(command{ "Q" });
+}
+
+bool pg_connection::start_send_prepared_query(const std::string& name, const std::list<pg_param>& params, bool single_row, pg_format format) {
+
+	if (!can_send()) {
+		return false;
+	}
+
+	// this will change async_state if something wrong
+	if (connectPoll() != PostgresPollingStatusType::PGRES_POLLING_OK) {
+		return false;
+	}
+
+	if (!send_query_prepared(name, params, format)) {
+		return false;
+	}
+
+	if (single_row) {
+		single_row_mode();
+	}
+	return sent(command{ "Q" });
+}
+
+bool pg_connection::start_send_prepared_statement(const std::string& name, const std::string& sql) {
+
+	if (!can_send()) {
+		return false;
+	}
+
+	// this will change async_state if something wrong
+	if (connectPoll() != PostgresPollingStatusType::PGRES_POLLING_OK) {
+		return false;
+	}
 
-		int r = PQsendQueryParams(_conn, sql.c_str(), n_params, nullptr, values, lengths, formats, 0);
-		delete[] values;
-		delete[] lengths;
-		delete[] formats;
-		if (r == 0) {
+	if (PQsendPrepare(_conn, name.c_str(), sql.c_str(), 0, nullptr) == 0) {
+		_last_error = PQerrorMessage(_conn);
+		return false;
+	}
+
+	if (!sent(command{ "P", { name } })) {
+		return false;
+	}
+	_prepared_statements.insert(name);
+	return true;
+}
+
+bool pg_connection::start_send_prepare_and_query(const std::string& name, const std::string& sql, const std::list<pg_param>& params, const std::vector<Oid>& param_types, pg_format format) {
+
+	if (!can_send()) {
+		return false;
+	}
+
+	// this will change async_state if something wrong
+	if (connectPoll() != PostgresPollingStatusType::PGRES_POLLING_OK) {
+		return false;
+	}
+
+	//	Parse, Bind, Execute and Sync are written in one flush, which needs pipeline mode.
+	//	A connection that is not pipelined enters it for this command only, see get_results.
+	if (!enter_pipeline()) {
+		return false;
+	}
+
+	// Parse is queued once PQsendPrepare succeeds, the connection cannot be reused as is after a failure
+	if (PQsendPrepare(_conn, name.c_str(), sql.c_str(), (int)param_types.size(), param_types.data()) == 0 || !send_query_prepared(name, params, format)) {
+		_last_error = PQerrorMessage(_conn);
+		_async_state = async_state_t::connection_abort;
+		return false;
+	}
+
+	if (!sent(command{ "PQ", { name } })) {
+		return false;
+	}
+	_prepared_statements.insert(name);
+	return true;
+}
+
+bool pg_connection::start_send_prepare(const std::vector<pg_prepared>& statements) {
+
+	if (!can_send()) {
+		return false;
+	}
+
+	// this will change async_state if something wrong
+	if (connectPoll() != PostgresPollingStatusType::PGRES_POLLING_OK) {
+		return false;
+	}
+
+	// all statements are prepared in one flush, see start_send_prepare_and_query
+	if (!enter_pipeline()) {
+		return false;
+	}
+
+	// every statement gets its own sync point, so one that fails does not abort the others
+	command c;
+	c.syncs = 0;
+	for (auto& st : statements) {
+		if (PQsendPrepare(_conn, st.name().c_str(), st.sql().c_str(), (int)st.param_types().size(), st.param_types().data()) == 0 ||
+			PQpipelineSync(_conn) == 0) {
 			_last_error = PQerrorMessage(_conn);
+			_async_state = async_state_t::connection_abort;
 			return false;
 		}
+		c.ops.push_back('P');
+		c.parsed.push_back(st.name());
+		++c.syncs;
+		_prepared_statements.insert(st.name());
 	}
 
-	//	After sending any command or data on a nonblocking connection, call PQflush. 
-	// 	Returns 1 if it was unable to send all the data in the send queue yet 
-	if (PQflush(_conn) == 1) {
-		_need_flush = true;
+	return sent(std::move(c), false);
+}
+
+bool pg_connection::start_send_batch(const std::vector<pg_statement>& statements, bool transaction) {
+
+	if (!can_send()) {
+		return false;
 	}
 
-	_async_state = async_state_t::executing_query;
-	return true;
+	// this will change async_state if something wrong
+	if (connectPoll() != PostgresPollingStatusType::PGRES_POLLING_OK) {
+		return false;
+	}
+
+	// all statements are queued in pipeline mode and flushed together
+	if (!enter_pipeline()) {
+		return false;
+	}
+
+	// Statements sent before one Sync run in one implicit transaction, the first error aborts the rest.
+	// Otherwise every statement gets its own sync point and fails on its own.
+	command c;
+	c.syncs = 0;
+	for (auto& st : statements) {
+		bool ok = true;
+		if (st.name().empty()) {
+			ok = send_query_params(st.sql(), st.params(), pg_format::text);
+		}
+		else {
+			if (!has_prepared_statement(st.name())) {
+				ok = PQsendPrepare(_conn, st.name().c_str(), st.sql().c_str(), 0, nullptr) == 1;
+				if (ok) {
+					c.ops.push_back('P');
+					c.parsed.push_back(st.name());
+					_prepared_statements.insert(st.name());
+				}
+			}
+			ok = ok && send_query_prepared(st.name(), st.params(), pg_format::text);
+		}
+		c.ops.push_back('Q');
+
+		if (ok && !transaction) {
+			ok = PQpipelineSync(_conn) == 1;
+			++c.syncs;
+		}
+
+		if (!ok) {
+			// part of the batch is queued already, the connection cannot be reused as is
+			_last_error = PQerrorMessage(_conn);
+			_async_state = async_state_t::connection_abort;
+			return false;
+		}
+	}
+
+	if (transaction) {
+		c.syncs = 1;
+		return sent(std::move(c));
+	}
+	return sent(std::move(c), false);
 }
 
-bool pg_connection::start_send_prepared_query(const std::string& name, const std::list<pg_param>& params) {
+bool pg_connection::start_send_copy(const std::string& sql) {
 
 	if (_async_state != async_state_t::idle) {
 		return false;
@@ -177,6 +346,82 @@ bool pg_connection::start_send_prepared_query(const std::string& name, const std
 		return false;
 	}
 
+	// COPY is not allowed in pipeline mode, a pipelined connection enters it again once the copy completed
+	if (PQpipelineStatus(_conn) != PQ_PIPELINE_OFF && PQexitPipelineMode(_conn) == 0) {
+		_last_error = PQerrorMessage(_conn);
+		return false;
+	}
+
+	if (PQsendQuery(_conn, sql.c_str()) == 0) {
+		_last_error = PQerrorMessage(_conn);
+		return false;
+	}
+
+	return sent(command{ "C" });
+}
+
+bool pg_connection::put_copy_data(const std::string& data) {
+
+	//	PQputCopyData grows the output buffer rather than returning 0 on a nonblocking connection,
+	//	the caller sends the next chunk only once the previous one is flushed, see poll_write.
+	if (PQputCopyData(_conn, data.data(), (int)data.size()) != 1) {
+		_last_error = PQerrorMessage(_conn);
+		_copy_in = false;	// the server ended the copy, its error is the result of the command
+		return false;
+	}
+	return write();
+}
+
+bool pg_connection::end_copy(const std::string& reason) {
+	_copy_in = false;
+	if (PQputCopyEnd(_conn, reason.empty() ? nullptr : reason.c_str()) != 1) {
+		_last_error = PQerrorMessage(_conn);
+		return false;
+	}
+	return write();
+}
+
+int pg_connection::get_copy_data(const char*& data) {
+
+	if (_copy_row) {
+		PQfreemem(_copy_row);
+		_copy_row = nullptr;
+	}
+
+	//	Returns the row size, 0 if no complete row is available yet in async mode,
+	//	-1 once the copy is done and -2 on failure, PQgetResult then returns the final result.
+	int n = PQgetCopyData(_conn, &_copy_row, 1);
+	if (n > 0) {
+		data = _copy_row;
+		return n;
+	}
+	if (n == 0) {
+		return 0;
+	}
+	if (n == -2) {
+		_last_error = PQerrorMessage(_conn);
+	}
+	_copy_out = false;
+	return -1;
+}
+
+bool pg_connection::has_prepared_statement(const std::string& name) {
+	return _prepared_statements.count(name) > 0;
+}
+
+bool pg_connection::can_send() {
+	if (_async_state == async_state_t::idle) {
+		return true;
+	}
+	// libpq takes no other command until a copy is over
+	if (_copy_in || _copy_out) {
+		return false;
+	}
+	return pipelined() && _async_state == async_state_t::executing_query && _in_flight < _pipeline_depth;
+}
+
+bool pg_connection::send_query_params(const std::string& sql, const std::list<pg_param>& params, pg_format format) {
+
 	int n_params = (int) params.size();
 	char** values = new char* [n_params];
 	int* lengths = new int[n_params];
@@ -189,7 +434,7 @@ bool pg_connection::start_send_prepared_query(const std::string& name, const std
 		++i;
 	}
 
-	int r = PQsendQueryPrepared(_conn, name.c_str(), n_params, values, lengths, formats, 0);
+	int r = PQsendQueryParams(_conn, sql.c_str(), n_params, nullptr, values, lengths, formats, (int)format);
 	delete[] values;
 	delete[] lengths;
 	delete[] formats;
@@ -197,46 +442,85 @@ bool pg_connection::start_send_prepared_query(const std::string& name, const std
 		_last_error = PQerrorMessage(_conn);
 		return false;
 	}
+	return true;
+}
 
-	//	After sending any command or data on a nonblocking connection, call PQflush. 
-	// 	Returns 1 if it was unable to send all the data in the send queue yet 
-	if (PQflush(_conn) == 1) {
-		_need_flush = true;
+bool pg_connection::send_query_prepared(const std::string& name, const std::list<pg_param>& params, pg_format format) {
+
+	int n_params = (int) params.size();
+	char** values = new char* [n_params];
+	int* lengths = new int[n_params];
+	int* formats = new int[n_params];
+	int i = 0;
+	for (auto& p : params) {
+		values[i] = (char*)p.data();
+		lengths[i] = (int)p.size();
+		formats[i] = (int)p.is_binary();
+		++i;
 	}
 
-	_async_state = async_state_t::executing_query;
+	int r = PQsendQueryPrepared(_conn, name.c_str(), n_params, values, lengths, formats, (int)format);
+	delete[] values;
+	delete[] lengths;
+	delete[] formats;
+	if (r == 0) {
+		_last_error = PQerrorMessage(_conn);
+		return false;
+	}
 	return true;
 }
 
-bool pg_connection::start_send_prepared_statement(const std::string& name, const std::string& sql) {
-
-	if (_async_state != async_state_t::idle) {
+bool pg_connection::enter_pipeline() {
+	if (PQpipelineStatus(_conn) == PQ_PIPELINE_OFF && PQenterPipelineMode(_conn) == 0) {
+		_last_error = PQerrorMessage(_conn);
 		return false;
 	}
+	return true;
+}
 
-	// this will change async_state if something wrong
-	if (connectPoll() != PostgresPollingStatusType::PGRES_POLLING_OK) {
-		return false;
+void pg_connection::single_row_mode() {
+	//	PQsetSingleRowMode applies to the command libpq is processing, so only to a query sent
+	//	with nothing in flight. It fails otherwise and the rows come in one result as usual.
+	if (_in_flight == 0) {
+		PQsetSingleRowMode(_conn);
 	}
+}
 
-	if (PQsendPrepare(_conn, name.c_str(), sql.c_str(), 0, nullptr) == 0) {
+bool pg_connection::sent(command&& c, bool sync) {
+
+	// in pipeline mode every command gets its own sync point,
+	// so an error aborts only that command and its results end with PGRES_PIPELINE_SYNC
+	if (sync && PQpipelineStatus(_conn) != PQ_PIPELINE_OFF && PQpipelineSync(_conn) == 0) {
 		_last_error = PQerrorMessage(_conn);
 		return false;
 	}
 
-
 	//	After sending any command or data on a nonblocking connection, call PQflush. 
 	// 	Returns 1 if it was unable to send all the data in the send queue yet 
 	if (PQflush(_conn) == 1) {
 		_need_flush = true;
 	}
-	_prepared_statements.insert(name);
+
+	++_in_flight;
+	_commands.push_back(std::move(c));
 	_async_state = async_state_t::executing_query;
 	return true;
 }
 
-bool pg_connection::has_prepared_statement(const std::string& name) {
-	return _prepared_statements.count(name) > 0;
+void pg_connection::connected() {
+	_async_state = async_state_t::idle;
+	_prepared_statements.clear();
+	_partial.clear();
+	_commands.clear();
+	_in_flight = 0;
+	_need_flush = false;
+	_copy_in = false;
+	_copy_out = false;
+
+	if (pipelined() && PQenterPipelineMode(_conn) == 0) {
+		_last_error = PQerrorMessage(_conn);
+		_async_state = async_state_t::connection_abort;
+	}
 }
 
 bool pg_connection::poll_read() {
@@ -252,7 +536,7 @@ int pg_connection::socket() {
 	return PQsocket(_conn);
 }
 
-bool pg_connection::get_results(std::list<pg_result>& results) {
+bool pg_connection::get_results(std::list<pg_result>& results, std::list<pg_result>& rows) {
 
 	if (_async_state != async_state_t::executing_query) {
 		return false;
@@ -260,17 +544,134 @@ bool pg_connection::get_results(std::list<pg_result>& results) {
 
 	//	Returns 1 if a command is busy, that is, PQgetResult would block waiting for input. 
 	//	A 0 return indicates that PQgetResult can be called with assurance of not blocking.
-	if (PQisBusy(_conn) == 1) {
-		return false;
+	//	PQisBusy is checked before every PQgetResult: in single-row mode the next row
+	//	might not be received yet and PQgetResult would block for it.
+	if (PQpipelineStatus(_conn) == PQ_PIPELINE_OFF) {
+		while (true) {
+			if (PQisBusy(_conn) == 1) {
+				return false;
+			}
+			PGresult* res = PQgetResult(_conn);
+			if (!res) {
+				break;
+			}
+			// returned again on every call until the copy ends
+			if (PQresultStatus(res) == PGRES_COPY_IN) {
+				PQclear(res);
+				_copy_in = true;
+				return false;
+			}
+			if (PQresultStatus(res) == PGRES_COPY_OUT) {
+				PQclear(res);
+				_copy_out = true;
+				return false;
+			}
+			if (PQresultStatus(res) == PGRES_SINGLE_TUPLE) {
+				rows.push_back(pg_result(res));
+			}
+			else {
+				_partial.push_back(pg_result(res));
+			}
+		}
+
+		results.splice(results.end(), _partial);
+		_need_flush = false;
+		_in_flight = 0;
+		_commands.clear();
+		_async_state = async_state_t::idle;
+
+		// back from a copy, see start_send_copy
+		if (pipelined() && PQenterPipelineMode(_conn) == 0) {
+			_last_error = PQerrorMessage(_conn);
+			_async_state = async_state_t::connection_abort;
+		}
+		return true;
+	}
+
+	// In pipeline mode results of one command are followed by nullptr and then by PGRES_PIPELINE_SYNC.
+	// Returns true once per completed command, call it until it returns false.
+	bool end_of_command = false;
+	while (PQisBusy(_conn) == 0) {
+		PGresult* res = PQgetResult(_conn);
+		if (!res) {
+			// two nullptr in a row: nothing else is queued in libpq
+			if (end_of_command) {
+				break;
+			}
+			end_of_command = true;
+			continue;
+		}
+		end_of_command = false;
+
+		if (PQresultStatus(res) == PGRES_SINGLE_TUPLE) {
+			rows.push_back(pg_result(res));
+			continue;
+		}
+		if (PQresultStatus(res) != PGRES_PIPELINE_SYNC) {
+			_partial.push_back(pg_result(res));
+			continue;
+		}
+
+		PQclear(res);
+
+		command& c = _commands.front();
+		if (--c.syncs > 0) {
+			continue;
+		}
+		collect(c, results);
+		_commands.pop_front();
+
+		if (--_in_flight == 0) {
+			_async_state = async_state_t::idle;
+
+			// leave the pipeline mode entered by start_send_prepare_and_query
+			if (!pipelined() && PQexitPipelineMode(_conn) == 0) {
+				_last_error = PQerrorMessage(_conn);
+				_async_state = async_state_t::connection_abort;
+			}
+		}
+		return true;
 	}
+	return false;
+}
+
+void pg_connection::collect(command& c, std::list<pg_result>& results) {
+
+	// Every queued libpq command produced exactly one result.
+	// Successful statement preparations are dropped. A failed one replaces the result
+	// of the query that used it, which is PGRES_PIPELINE_ABORTED, and the statement is forgotten.
+	// A failed preparation not followed by a query is kept as is.
+	auto it = _partial.begin();
+	std::size_t parsed = 0;
+	for (std::size_t i = 0; i < c.ops.size() && it != _partial.end(); ++i) {
+		if (c.ops[i] != 'P') {
+			++it;
+			continue;
+		}
+
+		const std::string& name = c.parsed[parsed++];
+		if (it->status() == PGRES_COMMAND_OK) {
+			it = _partial.erase(it);
+			continue;
+		}
 
-	while (PGresult* res = PQgetResult(_conn)) {
-		results.push_back(pg_result(res));
+		_prepared_statements.erase(name);
+		++it;
+		if (i + 1 < c.ops.size() && c.ops[i + 1] == 'Q' && it != _partial.end()) {
+			it = _partial.erase(it);
+			++i;
+		}
 	}
 
-	_need_flush = false;
-	_async_state = async_state_t::idle;
-	return true;
+	results.splice(results.end(), _partial);
+}
+
+PGcancel* pg_connection::get_cancel() {
+	PGcancel* cancel = PQgetCancel(_conn);
+	if (!cancel) {
+		_last_error = "PQgetCancel failed";
+	}
+	return cancel;
 }
 
 bool pg_connection::get_notifies() {
@@ -7,10 +7,14 @@
 #include <mutex>
 #include <condition_variable>
 #include <list>
+#include <deque>
+#include <vector>
 #include <unordered_set>
 
 #include "pg_result.hpp"
 #include "pg_query.hpp"
+#include "pg_statement.hpp"
+#include "pg_prepared.hpp"
 #include "libpq-fe.h"
 
 class pg_connection {
@@ -20,20 +24,51 @@ public:
 	pg_connection(pg_connection&&) = delete;
 	pg_connection& operator=(pg_connection&&) = delete;
 
-	pg_connection(int id);
+	// pipeline_depth > 1 puts the connection in libpq pipeline mode,
+	// up to pipeline_depth commands are then in flight at once
+	pg_connection(int id, int pipeline_depth = 1);
 	~pg_connection();
 
 	bool start_connect(const std::map<std::string, std::string>& params);
 	bool start_reset();
+	// closes the connection, start_connect opens it again
+	void close();
 	
-	bool start_send_query(const std::string& sql, const std::list<pg_param>& params = {});
-	bool start_send_prepared_query(const std::string& name, const std::list<pg_param>& params = {});
+	// single_row asks libpq for the rows one by one, see get_results. It only applies to a query sent
+	// while nothing else is in flight, the rows come at the end otherwise.
+	// format is the format of the result values, see pg_format.
+	bool start_send_query(const std::string& sql, const std::list<pg_param>& params = {}, bool single_row = false, pg_format format = pg_format::text);
+	bool start_send_prepared_query(const std::string& name, const std::list<pg_param>& params = {}, bool single_row = false, pg_format format = pg_format::text);
 	bool start_send_prepared_statement(const std::string& name, const std::string& sql);
+	bool start_send_prepare_and_query(const std::string& name, const std::string& sql, const std::list<pg_param>& params = {}, const std::vector<Oid>& param_types = {}, pg_format format = pg_format::text);
+	bool start_send_prepare(const std::vector<pg_prepared>& statements);
+	bool start_send_batch(const std::vector<pg_statement>& statements, bool transaction);
+
+	// COPY FROM STDIN or TO STDOUT, sent while nothing else is in flight. Once the server accepted
+	// a COPY FROM STDIN copying() is set, data is then sent with put_copy_data until end_copy,
+	// which fails the copy if reason is not empty.
+	bool start_send_copy(const std::string& sql);
+	bool copying() const { return _copy_in; }
+	bool put_copy_data(const std::string& data);
+	bool end_copy(const std::string& reason);
+
+	// COPY TO STDOUT: once get_results saw the server start it copying_out() is set and the rows are taken
+	// with get_copy_data. It returns the size of the next row, valid until the next call, 0 while no complete
+	// row was received and -1 once the copy is over, get_results then returns its result.
+	bool copying_out() const { return _copy_out; }
+	int get_copy_data(const char*& data);
+
 	bool has_prepared_statement(const std::string& name);
+	bool can_send();
 
-	bool get_results(std::list<pg_result>& results);
+	// Returns true once per completed command with its results. Rows of a query in single-row mode
+	// are appended to rows as they arrive, whether the command completed or not.
+	bool get_results(std::list<pg_result>& results, std::list<pg_result>& rows);
 	bool get_notifies();
 
+	// cancel request for the command in progress, to be sent with PQcancel and freed with PQfreeCancel
+	PGcancel* get_cancel();
+
 	int socket();
 	bool read();
 	bool write();
@@ -55,12 +90,37 @@ public:
 	const async_state_t& async_state() { return _async_state; }
 	const std::string& last_error() const { return _last_error; }
 	const int& id() const { return _id; }
+	const int& in_flight() const { return _in_flight; }
+	bool pipelined() const { return _pipeline_depth > 1; }
 
 private:
+	// A command in flight: one char per queued libpq command, 'P' for a statement preparation
+	// and 'Q' for a query, and the number of sync points that end it
+	struct command {
+		std::string ops;
+		std::vector<std::string> parsed;	// statements prepared by the command, in order
+		int syncs = 1;
+	};
+
+	bool send_query_params(const std::string& sql, const std::list<pg_param>& params, pg_format format);
+	bool send_query_prepared(const std::string& name, const std::list<pg_param>& params, pg_format format);
+	bool enter_pipeline();
+	void single_row_mode();
+	bool sent(command&& c, bool sync = true);
+	void collect(command& c, std::list<pg_result>& results);
+	void connected();
+
 	int _id;
+	int _pipeline_depth;
+	int _in_flight;				// commands sent and not yet completed
+	std::list<pg_result> _partial;	// results of the pipelined command being received
+	std::deque<command> _commands;	// in pipeline mode, in send order
 	PGconn* _conn;
 	std::string _last_error;
 	bool _need_flush;
+	bool _copy_in;		// the server waits for COPY data
+	bool _copy_out;		// the server sends COPY data
+	char* _copy_row;	// last row returned by get_copy_data, freed on the next call
 	async_state_t _async_state;
 	std::unordered_set<std::string> _prepared_statements;
 };
\ No newline at end of file
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+// Error of a query whose connection was lost while the query was in flight.
+// The query may or may not have run on the server.
+class pg_connection_error : public std::runtime_error {
+public:
+	explicit pg_connection_error(const std::string& error) : std::runtime_error(error) {}
+};
@@ -0,0 +1,49 @@
+#include "pg_copy_buffer.hpp"
+
+pg_copy_buffer::pg_copy_buffer(std::size_t capacity) : _capacity(capacity ? capacity : 1) {}
+
+std::size_t pg_copy_buffer::read(std::string& out) {
+
+	bool full;
+	std::size_t n;
+	{
+		std::unique_lock<std::mutex> lock(_mtx);
+		_cv.wait(lock, [this] { return _data.size() || _done; });
+		n = _data.size();
+		if (out.empty()) {
+			out.swap(_data);
+		}
+		else {
+			out.append(_data);
+		}
+		_data.clear();
+		full = _full;
+		_full = false;
+		if (n == 0 && _error) {
+			std::rethrow_exception(_error);
+		}
+	}
+
+	// outside the lock, the reactor takes it in write
+	if (full) {
+		resume();
+	}
+	return n;
+}
+
+bool pg_copy_buffer::write(const char* data, std::size_t size) {
+	std::lock_guard<std::mutex> lock(_mtx);
+	if (_data.empty()) {
+		_cv.notify_one();
+	}
+	_data.append(data, size);
+	_full = _data.size() >= _capacity;
+	return !_full;
+}
+
+void pg_copy_buffer::end(std::exception_ptr error) {
+	std::lock_guard<std::mutex> lock(_mtx);
+	_done = true;
+	_error = error;
+	_cv.notify_all();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <string>
+#include "pg_copy_sink.hpp"
+
+// COPY data handed over to a consumer thread: the reactor appends rows, the consumer takes
+// everything received so far with read. Up to capacity bytes are buffered, the connection
+// is not read beyond that until the consumer took them.
+// The reactor and the consumer swap two buffers, so the data is not copied again on the way.
+class pg_copy_buffer : public pg_copy_sink {
+public:
+	explicit pg_copy_buffer(std::size_t capacity = 1 << 20);
+
+	// Waits for data and appends it to out, whole rows. Returns the number of bytes appended,
+	// 0 once the copy completed and throws its error if it failed.
+	std::size_t read(std::string& out);
+
+	bool write(const char* data, std::size_t size) override;
+	void end(std::exception_ptr error) override;
+
+private:
+	std::mutex _mtx;
+	std::condition_variable _cv;
+	std::string _data;
+	std::size_t _capacity;
+	std::exception_ptr _error;
+	bool _full = false;		// write returned false, the reactor waits for resume
+	bool _done = false;
+};
@@ -0,0 +1,113 @@
+#include "pg_copy_encoder.hpp"
+#include <cstring>
+
+namespace {
+	// seconds from the Unix epoch to the PostgreSQL one, 2000-01-01
+	constexpr int64_t pg_epoch_s = 946684800;
+}
+
+pg_copy_encoder::pg_copy_encoder() {
+	// signature, flags and header extension length
+	_data.append("PGCOPY\n\377\r\n\0", 11);
+	put32(0);
+	put32(0);
+}
+
+pg_copy_encoder& pg_copy_encoder::row(int16_t fields) {
+	put16((uint16_t)fields);
+	return *this;
+}
+
+pg_copy_encoder& pg_copy_encoder::add(bool value) {
+	put32(1);
+	_data.push_back(value ? 1 : 0);
+	return *this;
+}
+
+pg_copy_encoder& pg_copy_encoder::add(int16_t value) {
+	put32(2);
+	put16((uint16_t)value);
+	return *this;
+}
+
+pg_copy_encoder& pg_copy_encoder::add(int32_t value) {
+	put32(4);
+	put32((uint32_t)value);
+	return *this;
+}
+
+pg_copy_encoder& pg_copy_encoder::add(int64_t value) {
+	put32(8);
+	put64((uint64_t)value);
+	return *this;
+}
+
+pg_copy_encoder& pg_copy_encoder::add(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	put32(4);
+	put32(bits);
+	return *this;
+}
+
+pg_copy_encoder& pg_copy_encoder::add(double value) {
+	uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	put32(8);
+	put64(bits);
+	return *this;
+}
+
+pg_copy_encoder& pg_copy_encoder::add(const char* value) {
+	return add(value, std::strlen(value));
+}
+
+pg_copy_encoder& pg_copy_encoder::add(const char* data, std::size_t size) {
+	put32((uint32_t)size);
+	_data.append(data, size);
+	return *this;
+}
+
+pg_copy_encoder& pg_copy_encoder::add(const std::string& value) {
+	return add(value.data(), value.size());
+}
+
+pg_copy_encoder& pg_copy_encoder::add(std::chrono::system_clock::time_point value) {
+	// microseconds since the PostgreSQL epoch
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(value.time_since_epoch()).count();
+	put32(8);
+	put64((uint64_t)(us - pg_epoch_s * 1000000));
+	return *this;
+}
+
+pg_copy_encoder& pg_copy_encoder::add_null() {
+	put32((uint32_t)-1);
+	return *this;
+}
+
+pg_copy_encoder& pg_copy_encoder::end() {
+	put16((uint16_t)-1);
+	return *this;
+}
+
+std::string pg_copy_encoder::take() {
+	std::string data;
+	data.swap(_data);
+	return data;
+}
+
+// network byte order whatever the host order
+void pg_copy_encoder::put16(uint16_t value) {
+	char b[2] = { (char)(value >> 8), (char)value };
+	_data.append(b, 2);
+}
+
+void pg_copy_encoder::put32(uint32_t value) {
+	char b[4] = { (char)(value >> 24), (char)(value >> 16), (char)(value >> 8), (char)value };
+	_data.append(b, 4);
+}
+
+void pg_copy_encoder::put64(uint64_t value) {
+	put32((uint32_t)(value >> 32));
+	put32((uint32_t)value);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Encoder of COPY ... FROM STDIN (FORMAT binary) data, see pg_copy_writer.
+// Every row is row(n) followed by n values, in the column order of the COPY statement.
+// Values have to match the column types exactly, the server does not convert binary data:
+// int16_t for smallint, int32_t for integer, int64_t for bigint, float for real, double for
+// double precision, strings for text, varchar and bytea, time points for timestamp and timestamptz.
+//
+//	pg_copy_encoder enc;
+//	for (auto& e : events) {
+//		enc.row(3).add(e.device).add(e.at).add(e.payload);
+//		if (enc.size() >= 64 * 1024) {
+//			writer->write(enc.take());
+//		}
+//	}
+//	writer->write(enc.end().take());
+class pg_copy_encoder {
+public:
+	// starts with the header of the binary format
+	pg_copy_encoder();
+
+	pg_copy_encoder& row(int16_t fields);
+
+	pg_copy_encoder& add(bool value);
+	pg_copy_encoder& add(int16_t value);
+	pg_copy_encoder& add(int32_t value);
+	pg_copy_encoder& add(int64_t value);
+	pg_copy_encoder& add(float value);
+	pg_copy_encoder& add(double value);
+	pg_copy_encoder& add(const char* value);
+	pg_copy_encoder& add(const char* data, std::size_t size);
+	pg_copy_encoder& add(const std::string& value);
+	pg_copy_encoder& add(std::chrono::system_clock::time_point value);
+	pg_copy_encoder& add_null();
+
+	// appends the trailer, after the last row
+	pg_copy_encoder& end();
+
+	// the data encoded so far, the encoder goes on with an empty buffer
+	std::string take();
+	const std::string& data() const { return _data; }
+	std::size_t size() const { return _data.size(); }
+
+private:
+	void put16(uint16_t value);
+	void put32(uint32_t value);
+	void put64(uint64_t value);
+
+	std::string _data;
+};
@@ -0,0 +1,38 @@
+#include "pg_copy_fd_sink.hpp"
+#include <errno.h>
+#include <unistd.h>
+
+pg_copy_fd_sink::pg_copy_fd_sink(int fd, std::size_t buffer_size) :
+	_fd(fd),
+	_buffer_size(buffer_size)
+{
+	_buffer.reserve(buffer_size);
+}
+
+bool pg_copy_fd_sink::write(const char* data, std::size_t size) {
+	_buffer.append(data, size);
+	if (_buffer.size() >= _buffer_size) {
+		flush();
+	}
+	return true;
+}
+
+void pg_copy_fd_sink::end(std::exception_ptr error) {
+	flush();
+}
+
+void pg_copy_fd_sink::flush() {
+	std::size_t off = 0;
+	while (_errno == 0 && off < _buffer.size()) {
+		ssize_t r = ::write(_fd, _buffer.data() + off, _buffer.size() - off);
+		if (r < 0) {
+			if (errno != EINTR) {
+				_errno = errno;
+			}
+			continue;
+		}
+		off += r;
+	}
+	_written += off;
+	_buffer.clear();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "pg_copy_sink.hpp"
+
+// COPY data written to a file descriptor as it arrives, e.g. an export file.
+// Writes block the reactor thread, so fd should be a regular file; pipes and sockets
+// that might stall are better served from another thread through a pg_copy_buffer.
+// Rows are buffered up to buffer_size bytes and written together.
+class pg_copy_fd_sink : public pg_copy_sink {
+public:
+	explicit pg_copy_fd_sink(int fd, std::size_t buffer_size = 64 * 1024);
+
+	bool write(const char* data, std::size_t size) override;
+	void end(std::exception_ptr error) override;
+
+	// errno of the first failed write, 0 if none; later data is dropped
+	int error() const { return _errno; }
+	std::size_t written() const { return _written; }
+
+private:
+	void flush();
+
+	int _fd;
+	std::size_t _buffer_size;
+	std::string _buffer;
+	std::size_t _written = 0;
+	int _errno = 0;
+};
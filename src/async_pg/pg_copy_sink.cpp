@@ -0,0 +1,38 @@
+#include "pg_copy_sink.hpp"
+#include "pg_reactor.hpp"
+
+void pg_copy_sink::resume() {
+	// the reactor is resumed under the lock, it cannot complete the copy and go away meanwhile
+	std::lock_guard<std::mutex> lock(_mtx);
+	if (_paused) {
+		_paused->resume();
+		_paused = nullptr;
+	}
+	else {
+		_resumed = true;
+	}
+}
+
+bool pg_copy_sink::pause(pg_reactor* reactor) {
+	std::lock_guard<std::mutex> lock(_mtx);
+	if (_resumed) {
+		_resumed = false;
+		return false;
+	}
+	_paused = reactor;
+	return true;
+}
+
+bool pg_copy_sink::paused() {
+	std::lock_guard<std::mutex> lock(_mtx);
+	return _paused != nullptr;
+}
+
+void pg_copy_sink::finish(std::exception_ptr error) {
+	{
+		std::lock_guard<std::mutex> lock(_mtx);
+		_paused = nullptr;
+		_resumed = false;
+	}
+	end(error);
+}
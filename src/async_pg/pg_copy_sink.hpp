@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <mutex>
+
+class pg_reactor;
+
+// Receiver of COPY ... TO STDOUT data, see async_pg::copy_out.
+// The reactor hands over every row as libpq receives it, with no pg_result in between.
+// write runs on the reactor thread and must not block; a sink that cannot keep up returns false,
+// the reactor then stops reading the connection, the server blocks on its socket,
+// until the sink calls resume. See pg_copy_buffer and pg_copy_fd_sink.
+class pg_copy_sink {
+public:
+	pg_copy_sink(const pg_copy_sink&) = delete;
+	pg_copy_sink& operator=(const pg_copy_sink&) = delete;
+
+	pg_copy_sink() {}
+	virtual ~pg_copy_sink() {}
+
+	// One row of COPY data, taken whatever the return value. Returns false to pause the copy.
+	virtual bool write(const char* data, std::size_t size) = 0;
+
+	// The copy completed, error is null on success. Called on the reactor thread before the future of copy_out is set.
+	virtual void end(std::exception_ptr error) {}
+
+	// reads the connection again after write returned false, from any thread
+	void resume();
+
+private:
+	friend class pg_reactor;
+	friend class async_pg;
+
+	// false if resume was called since write returned false
+	bool pause(pg_reactor* reactor);
+	bool paused();
+	void finish(std::exception_ptr error);
+
+	std::mutex _mtx;
+	pg_reactor* _paused = nullptr;	// reactor to resume
+	bool _resumed = false;	// resume called before the reactor paused
+};
@@ -0,0 +1,103 @@
+#include "pg_copy_state.hpp"
+#include "pg_reactor.hpp"
+#include <stdexcept>
+
+pg_copy_state::pg_copy_state(std::size_t capacity) :
+	_capacity(capacity ? capacity : 1)
+{}
+
+void pg_copy_state::write(const char* data, std::size_t size) {
+
+	std::unique_lock<std::mutex> lock(_mtx);
+	_cv.wait(lock, [this] { return _buffer.size() < _capacity || _done; });
+	if (_done) {
+		std::rethrow_exception(_error ? _error : std::make_exception_ptr(std::runtime_error("copy completed")));
+	}
+	if (_end) {
+		throw std::runtime_error("copy data already ended");
+	}
+	_buffer.append(data, size);
+	resume();
+}
+
+bool pg_copy_state::try_write(const char* data, std::size_t size) {
+
+	std::lock_guard<std::mutex> lock(_mtx);
+	if (_done) {
+		std::rethrow_exception(_error ? _error : std::make_exception_ptr(std::runtime_error("copy completed")));
+	}
+	if (_end) {
+		throw std::runtime_error("copy data already ended");
+	}
+	if (_buffer.size() >= _capacity) {
+		return false;
+	}
+	_buffer.append(data, size);
+	resume();
+	return true;
+}
+
+void pg_copy_state::finish() {
+	std::lock_guard<std::mutex> lock(_mtx);
+	_end = true;
+	resume();
+}
+
+void pg_copy_state::abort(const std::string& reason) {
+	std::lock_guard<std::mutex> lock(_mtx);
+	_end = true;
+	_reason = reason.empty() ? "aborted" : reason;
+	_buffer.clear();
+	resume();
+}
+
+bool pg_copy_state::take(std::string& chunk, bool& end, std::string& reason, pg_reactor* reactor) {
+
+	std::lock_guard<std::mutex> lock(_mtx);
+	if (_buffer.empty() && !_end) {
+		_waiting = reactor;
+		return false;
+	}
+
+	// the buffers are swapped, the producer writes into the one the reactor has sent
+	chunk.swap(_buffer);
+	end = _end;
+	reason = _reason;
+	_cv.notify_all();
+	return true;
+}
+
+void pg_copy_state::complete(std::exception_ptr error, std::list<pg_result>&& results) {
+
+	// a COPY rejected by the server completes with its error result
+	for (auto& r : results) {
+		try {
+			r.check();
+		}
+		catch (...) {
+			if (!error) {
+				error = std::current_exception();
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(_mtx);
+	_done = true;
+	_error = error;
+	_waiting = nullptr;
+	if (error) {
+		_promise.set_exception(error);
+	}
+	else {
+		_promise.set_value(std::move(results));
+	}
+	_cv.notify_all();
+}
+
+void pg_copy_state::resume() {
+	// called under the lock, the reactor cannot complete the copy and go away meanwhile
+	if (_waiting) {
+		_waiting->resume();
+		_waiting = nullptr;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include "pg_result.hpp"
+
+class pg_reactor;
+
+// State of a COPY ... FROM STDIN shared by the query sending it and its pg_copy_writer,
+// which the caller may drop first: the buffered data, the end of the data and the result.
+class pg_copy_state {
+public:
+	pg_copy_state(const pg_copy_state&) = delete;
+	pg_copy_state& operator=(const pg_copy_state&) = delete;
+
+	explicit pg_copy_state(std::size_t capacity);
+
+private:
+	friend class async_pg;
+	friend class pg_copy_writer;
+	friend class pg_reactor;
+
+	// called by pg_copy_writer
+	void write(const char* data, std::size_t size);
+	bool try_write(const char* data, std::size_t size);
+	void finish();
+	void abort(const std::string& reason);
+
+	// Called by the reactor: swaps the buffered data into chunk and tells whether the data is over,
+	// with the abort reason if any. Returns false when there is nothing to send yet, the reactor
+	// is then resumed by the next write.
+	bool take(std::string& chunk, bool& end, std::string& reason, pg_reactor* reactor);
+	void complete(std::exception_ptr error, std::list<pg_result>&& results);
+	void resume();
+
+	std::mutex _mtx;
+	std::condition_variable _cv;
+	std::string _buffer;
+	std::size_t _capacity;
+	std::promise<std::list<pg_result>> _promise;
+	std::exception_ptr _error;
+	std::string _reason;
+	pg_reactor* _waiting = nullptr;	// reactor to resume, set while it has nothing to send
+	bool _end = false;
+	bool _done = false;
+};
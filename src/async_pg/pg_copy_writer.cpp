@@ -0,0 +1,38 @@
+#include "pg_copy_writer.hpp"
+#include <stdexcept>
+
+pg_copy_writer::pg_copy_writer(std::shared_ptr<pg_copy_state> state) :
+	_state(std::move(state)),
+	_future(_state->_promise.get_future())
+{}
+
+pg_copy_writer::~pg_copy_writer() {
+	// the query holds the state, not the writer: nobody would end the data otherwise
+	if (_future.valid()) {
+		_state->abort("abandoned");
+	}
+}
+
+void pg_copy_writer::write(const char* data, std::size_t size) {
+	_state->write(data, size);
+}
+
+bool pg_copy_writer::try_write(const char* data, std::size_t size) {
+	return _state->try_write(data, size);
+}
+
+std::future<std::list<pg_result>> pg_copy_writer::finish() {
+	if (!_future.valid()) {
+		throw std::runtime_error("copy already finished or aborted");
+	}
+	_state->finish();
+	return std::move(_future);
+}
+
+std::future<std::list<pg_result>> pg_copy_writer::abort(const std::string& reason) {
+	if (!_future.valid()) {
+		throw std::runtime_error("copy already finished or aborted");
+	}
+	_state->abort(reason);
+	return std::move(_future);
+}
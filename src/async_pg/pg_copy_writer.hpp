@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <future>
+#include <list>
+#include <memory>
+#include <string>
+#include "pg_copy_state.hpp"
+#include "pg_result.hpp"
+
+// Data of a COPY ... FROM STDIN, see async_pg::copy_in.
+// The producer appends data in the format of the COPY statement, text or binary, see pg_copy_encoder,
+// and the reactor sends it while the socket takes it. Up to capacity bytes are buffered:
+// write blocks beyond that, try_write returns false, so a producer faster than the network
+// or the server waits instead of growing the buffer.
+// A writer dropped before finish or abort aborts the copy with "abandoned", its connection is freed.
+class pg_copy_writer {
+public:
+	pg_copy_writer(const pg_copy_writer&) = delete;
+	pg_copy_writer& operator=(const pg_copy_writer&) = delete;
+
+	explicit pg_copy_writer(std::shared_ptr<pg_copy_state> state);
+	~pg_copy_writer();
+
+	// Throws the error of the copy once it failed, e.g. on a lost connection or a rejected row.
+	void write(const char* data, std::size_t size);
+	void write(const std::string& data) { write(data.data(), data.size()); }
+	bool try_write(const char* data, std::size_t size);
+	bool try_write(const std::string& data) { return try_write(data.data(), data.size()); }
+
+	// Ends the data once it is sent. The future holds the result of the COPY,
+	// its rows_affected is the number of rows copied.
+	// finish and abort end the copy once, calling either of them again throws std::runtime_error.
+	std::future<std::list<pg_result>> finish();
+
+	// Ends the copy with an error instead, the server copies nothing.
+	std::future<std::list<pg_result>> abort(const std::string& reason);
+
+	std::size_t capacity() const { return _state->_capacity; }
+
+private:
+	std::shared_ptr<pg_copy_state> _state;
+	std::future<std::list<pg_result>> _future;	// taken by finish or abort
+};
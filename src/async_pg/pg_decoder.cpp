@@ -0,0 +1,191 @@
+#include "pg_decoder.hpp"
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+	// seconds from the Unix epoch to the PostgreSQL epoch, 2000-01-01
+	constexpr int64_t pg_epoch_s = 946684800;
+
+	// reads 1 to max digits
+	bool digits(const char*& p, const char* e, int max, int64_t& n) {
+		const char* b = p;
+		n = 0;
+		while (p < e && p - b < max && *p >= '0' && *p <= '9') {
+			n = n * 10 + (*p++ - '0');
+		}
+		return p > b;
+	}
+
+	bool skip(const char*& p, const char* e, char c) {
+		if (p < e && *p == c) {
+			++p;
+			return true;
+		}
+		return false;
+	}
+
+	// days since 1970-01-01 of a proleptic Gregorian date
+	int64_t days_from_civil(int64_t y, int64_t m, int64_t d) {
+		y -= m <= 2;
+		int64_t era = (y >= 0 ? y : y - 399) / 400;
+		int64_t yoe = y - era * 400;
+		int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+		int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+		return era * 146097 + doe - 719468;
+	}
+
+	// ISO DateStyle, the default: 2024-05-01 12:30:00[.123456][+02[:30]], no offset for timestamp
+	bool parse_timestamp(const char* p, const char* e, int64_t& us) {
+		int64_t y, mo, d, h, mi, s;
+		if (!(digits(p, e, 9, y) && skip(p, e, '-') && digits(p, e, 2, mo) && skip(p, e, '-') && digits(p, e, 2, d) && skip(p, e, ' ')
+			&& digits(p, e, 2, h) && skip(p, e, ':') && digits(p, e, 2, mi) && skip(p, e, ':') && digits(p, e, 2, s))) {
+			return false;
+		}
+		int64_t fraction = 0;
+		if (skip(p, e, '.')) {
+			const char* b = p;
+			if (!digits(p, e, 6, fraction)) {
+				return false;
+			}
+			for (auto n = p - b; n < 6; ++n) {
+				fraction *= 10;
+			}
+		}
+		int64_t offset = 0;
+		if (p < e && (*p == '+' || *p == '-')) {
+			int64_t sign = *p++ == '-' ? -1 : 1;
+			int64_t oh, om = 0, os = 0;
+			if (!digits(p, e, 2, oh) || (skip(p, e, ':') && !digits(p, e, 2, om)) || (skip(p, e, ':') && !digits(p, e, 2, os))) {
+				return false;
+			}
+			offset = sign * (oh * 3600 + om * 60 + os);
+		}
+		// BC dates and other DateStyles end up here
+		if (p != e) {
+			return false;
+		}
+		us = (days_from_civil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s - offset) * 1000000 + fraction;
+		return true;
+	}
+
+	int hex_digit(char c) {
+		if (c >= '0' && c <= '9') {
+			return c - '0';
+		}
+		if (c >= 'a' && c <= 'f') {
+			return c - 'a' + 10;
+		}
+		if (c >= 'A' && c <= 'F') {
+			return c - 'A' + 10;
+		}
+		return -1;
+	}
+
+}
+
+void pg_invalid_value(const char* type, const char* value) {
+	throw std::runtime_error(std::string("invalid ") + type + " value: " + value);
+}
+
+float pg_decoder<float>::parse(const char* value) {
+	// NaN and Infinity included
+	char* end;
+	float f = std::strtof(value, &end);
+	if (end == value || *end) {
+		pg_invalid_value(name, value);
+	}
+	return f;
+}
+
+double pg_decoder<double>::parse(const char* value) {
+	char* end;
+	double d = std::strtod(value, &end);
+	if (end == value || *end) {
+		pg_invalid_value(name, value);
+	}
+	return d;
+}
+
+bool pg_decoder<std::string_view>::accepts(Oid oid, bool binary) {
+	switch (oid) {
+	case pg_text_oid:
+	case pg_varchar_oid:
+	case pg_bpchar_oid:
+	case pg_name_oid:
+	case pg_char_oid:
+	case pg_json_oid:
+	case pg_xml_oid:
+	case pg_unknown_oid:
+		return true;
+	default:
+		return !binary;
+	}
+}
+
+pg_bytes pg_decoder<pg_bytes>::decode(const char* value, int length, bool binary) {
+	if (!binary) {
+		throw std::runtime_error("bytea in text format, it is read with pg_format::binary");
+	}
+	return pg_bytes((const uint8_t*)value, length);
+}
+
+pg_uuid pg_decoder<pg_uuid>::decode(const char* value, int length, bool binary) {
+	pg_uuid uuid;
+	if (binary) {
+		std::memcpy(uuid.bytes.data(), value, uuid.bytes.size());
+		return uuid;
+	}
+	const char* p = value;
+	for (auto& b : uuid.bytes) {
+		if (*p == '-') {
+			++p;
+		}
+		int hi = hex_digit(p[0]);
+		int lo = hi < 0 ? -1 : hex_digit(p[1]);
+		if (lo < 0) {
+			pg_invalid_value(name, value);
+		}
+		b = (uint8_t)(hi << 4 | lo);
+		p += 2;
+	}
+	if (*p) {
+		pg_invalid_value(name, value);
+	}
+	return uuid;
+}
+
+int64_t pg_decode_timestamp(const char* value, int length, bool binary) {
+	int64_t us;
+	if (binary) {
+		// microseconds since the PostgreSQL epoch
+		us = (int64_t)pg_be64(value);
+		if (us == std::numeric_limits<int64_t>::max() || us == std::numeric_limits<int64_t>::min()) {
+			return us;
+		}
+		return us + pg_epoch_s * 1000000;
+	}
+	if (std::strcmp(value, "infinity") == 0) {
+		return std::numeric_limits<int64_t>::max();
+	}
+	if (std::strcmp(value, "-infinity") == 0) {
+		return std::numeric_limits<int64_t>::min();
+	}
+	if (!parse_timestamp(value, value + length, us)) {
+		pg_invalid_value("timestamp", value);
+	}
+	return us;
+}
+
+std::chrono::system_clock::time_point pg_decoder<std::chrono::system_clock::time_point>::decode(const char* value, int length, bool binary) {
+	using time_point = std::chrono::system_clock::time_point;
+	int64_t us = pg_decode_timestamp(value, length, binary);
+	if (us == std::numeric_limits<int64_t>::max()) {
+		return time_point::max();
+	}
+	if (us == std::numeric_limits<int64_t>::min()) {
+		return time_point::min();
+	}
+	return time_point(std::chrono::duration_cast<time_point::duration>(std::chrono::microseconds(us)));
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "libpq-fe.h"
+#include "pg_types.hpp"
+
+// Decoders of result values by C++ type, see pg_result::get and pg_rows.
+// accepts tells if a column of type oid, in binary or text format, reads as T and is checked once per column;
+// decode reads a non null value of such a column in place. The small decoders are inline,
+// a loop over the rows of a column compiles to the decode of its type alone.
+template <typename T>
+struct pg_decoder;
+
+// binary values are in network byte order whatever the host order
+inline uint16_t pg_be16(const char* p) {
+	auto b = (const unsigned char*)p;
+	return (uint16_t)(b[0] << 8 | b[1]);
+}
+
+inline uint32_t pg_be32(const char* p) {
+	auto b = (const unsigned char*)p;
+	return (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 8 | b[3];
+}
+
+inline uint64_t pg_be64(const char* p) {
+	return (uint64_t)pg_be32(p) << 32 | pg_be32(p + 4);
+}
+
+// throws std::runtime_error
+[[noreturn]] void pg_invalid_value(const char* type, const char* value);
+
+// timestamp or timestamptz value in microseconds since the Unix epoch, infinity as the largest int64_t,
+// -infinity as the smallest. Throws std::runtime_error on text it cannot parse.
+int64_t pg_decode_timestamp(const char* value, int length, bool binary);
+
+template <typename T>
+T pg_parse_int(const char* value, int length, const char* type) {
+	T n = 0;
+	auto r = std::from_chars(value, value + length, n);
+	if (r.ec != std::errc() || r.ptr != value + length) {
+		pg_invalid_value(type, value);
+	}
+	return n;
+}
+
+template <>
+struct pg_decoder<bool> {
+	static constexpr const char* name = "bool";
+	static bool accepts(Oid oid, bool binary) { return oid == pg_bool_oid; }
+	static bool decode(const char* value, int length, bool binary) { return binary ? value[0] != 0 : value[0] == 't'; }
+};
+
+template <>
+struct pg_decoder<int16_t> {
+	static constexpr const char* name = "int16";
+	static bool accepts(Oid oid, bool binary) { return oid == pg_int2_oid; }
+	static int16_t decode(const char* value, int length, bool binary) {
+		return binary ? (int16_t)pg_be16(value) : pg_parse_int<int16_t>(value, length, name);
+	}
+};
+
+template <>
+struct pg_decoder<int32_t> {
+	static constexpr const char* name = "int32";
+	static bool accepts(Oid oid, bool binary) { return oid == pg_int4_oid || oid == pg_int2_oid; }
+	static int32_t decode(const char* value, int length, bool binary) {
+		if (binary) {
+			return length == 2 ? (int16_t)pg_be16(value) : (int32_t)pg_be32(value);
+		}
+		return pg_parse_int<int32_t>(value, length, name);
+	}
+};
+
+template <>
+struct pg_decoder<int64_t> {
+	static constexpr const char* name = "int64";
+	static bool accepts(Oid oid, bool binary) { return oid == pg_int8_oid || oid == pg_int4_oid || oid == pg_int2_oid; }
+	static int64_t decode(const char* value, int length, bool binary) {
+		if (binary) {
+			return length == 2 ? (int16_t)pg_be16(value) : length == 4 ? (int32_t)pg_be32(value) : (int64_t)pg_be64(value);
+		}
+		return pg_parse_int<int64_t>(value, length, name);
+	}
+};
+
+template <>
+struct pg_decoder<float> {
+	static constexpr const char* name = "float";
+	static bool accepts(Oid oid, bool binary) { return oid == pg_float4_oid; }
+	static float decode(const char* value, int length, bool binary) {
+		if (binary) {
+			uint32_t bits = pg_be32(value);
+			float f;
+			std::memcpy(&f, &bits, sizeof(f));
+			return f;
+		}
+		return parse(value);
+	}
+	static float parse(const char* value);
+};
+
+template <>
+struct pg_decoder<double> {
+	static constexpr const char* name = "double";
+	static bool accepts(Oid oid, bool binary) { return oid == pg_float8_oid || oid == pg_float4_oid; }
+	static double decode(const char* value, int length, bool binary) {
+		if (binary) {
+			if (length == 4) {
+				return pg_decoder<float>::decode(value, length, binary);
+			}
+			uint64_t bits = pg_be64(value);
+			double d;
+			std::memcpy(&d, &bits, sizeof(d));
+			return d;
+		}
+		return parse(value);
+	}
+	static double parse(const char* value);
+};
+
+// any value has a text form, binary values only for the string types
+template <>
+struct pg_decoder<std::string_view> {
+	static constexpr const char* name = "string";
+	static bool accepts(Oid oid, bool binary);
+	static std::string_view decode(const char* value, int length, bool binary) { return std::string_view(value, length); }
+};
+
+template <>
+struct pg_decoder<std::string> {
+	static constexpr const char* name = "string";
+	static bool accepts(Oid oid, bool binary) { return pg_decoder<std::string_view>::accepts(oid, binary); }
+	static std::string decode(const char* value, int length, bool binary) { return std::string(value, length); }
+};
+
+// the text form of bytea is hex encoded, there is nothing to point to: text bytea fails in decode
+template <>
+struct pg_decoder<pg_bytes> {
+	static constexpr const char* name = "bytes";
+	static bool accepts(Oid oid, bool binary) { return oid == pg_bytea_oid; }
+	static pg_bytes decode(const char* value, int length, bool binary);
+};
+
+template <>
+struct pg_decoder<pg_uuid> {
+	static constexpr const char* name = "uuid";
+	static bool accepts(Oid oid, bool binary) { return oid == pg_uuid_oid; }
+	static pg_uuid decode(const char* value, int length, bool binary);
+};
+
+// timestamp without time zone is taken as UTC, infinity as the largest time point
+template <>
+struct pg_decoder<std::chrono::system_clock::time_point> {
+	static constexpr const char* name = "time_point";
+	static bool accepts(Oid oid, bool binary) { return oid == pg_timestamptz_oid || oid == pg_timestamp_oid; }
+	static std::chrono::system_clock::time_point decode(const char* value, int length, bool binary);
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "pg_completion.hpp"
+
+// Runs completions of callback queries instead of the reactor thread, see async_pg::execute.
+// post is called on a reactor thread and must not block it.
+class pg_executor {
+public:
+	virtual ~pg_executor() = default;
+	virtual void post(pg_completion&& completion) = 0;
+};
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdio>
+
+#define log_error(...) printf(__VA_ARGS__); printf("\n")
+#define log_info(...) printf(__VA_ARGS__); printf("\n")
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+struct pg_pool_options {
+	// Connections opened at start, and the minimum the pool shrinks to.
+	int n_connections = 1;
+
+	// Above n_connections the pool grows when queries wait longer than grow_wait_ms or every connection
+	// stays busy with queries queued, one connection at a time. Connections idle for idle_timeout_ms
+	// are closed again down to n_connections. 0 keeps the pool at n_connections.
+	int max_connections = 0;
+	int grow_wait_ms = 10;
+	int idle_timeout_ms = 30000;
+
+	// The future returned by async_pg::start is ready once this many connections are up.
+	int ready_connections = 1;
+
+	// A connection that fails to connect or reset is retried after an exponential backoff
+	// from reconnect_min_ms up to reconnect_max_ms, each delay randomized between half and all of it.
+	// The first attempt after a connection is lost is immediate.
+	int reconnect_min_ms = 100;
+	int reconnect_max_ms = 10000;
+
+	// Queries in flight on a connection that is lost fail with pg_connection_error,
+	// except idempotent ones, which are queued again ahead of the others up to max_replays times.
+	// Queries not sent yet are never affected.
+	int max_replays = 1;
+
+	// Connections idle for keepalive_ms are probed with an empty query, so that a connection dropped
+	// by the network or a proxy is reset in the background instead of failing the next query.
+	// tcp_keepalive_s enables TCP keepalives with this idle time and probe interval, unless the
+	// connection parameters set them. Connections older than max_lifetime_ms are replaced once idle,
+	// one at a time per reactor, each lifetime shortened by up to a tenth at random. 0 disables each.
+	int keepalive_ms = 0;
+	int tcp_keepalive_s = 0;
+	int max_lifetime_ms = 0;
+
+	// Connections are split evenly between reactor threads, each with its own epoll instance.
+	int n_reactors = 1;
+
+	// No reactor thread: a single reactor is driven by the caller's event loop through
+	// async_pg::fd, timeout and run_once, and callbacks run inside run_once. n_reactors and cpus are ignored.
+	bool embedded = false;
+
+	// If not empty, reactor i is pinned to cpus[i % cpus.size()]
+	std::vector<int> cpus;
+
+	// Commands in flight per connection. Above 1 connections run in libpq pipeline mode:
+	// queries are written back-to-back and their results are matched in FIFO order.
+	// Queries without parameters then use the extended protocol, one statement per query.
+	int pipeline_depth = 1;
+
+	// A prepared query waits up to this long for a connection that already holds its statement
+	// before the statement is prepared on another one. 0 only prefers such connections when they are free.
+	int affinity_wait_us = 1000;
+
+	// Queries submitted and not yet sent, pool-wide. 0 is unbounded.
+	// When the queue is full execute either blocks or fails with "queue full", try_execute returns nothing.
+	std::size_t queue_capacity = 0;
+	enum class queue_full_t { block, fail };
+	queue_full_t queue_full = queue_full_t::block;
+
+	// CoDel-style load shedding, disabled when 0. When queries have waited longer than shed_target_ms
+	// in the queue for a whole shed_interval_ms, the reactor drops queued queries with "overloaded"
+	// at an increasing rate and new queries are rejected at submission until the wait is below target again.
+	int shed_target_ms = 0;
+	int shed_interval_ms = 100;
+};
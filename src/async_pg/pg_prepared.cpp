@@ -0,0 +1,4 @@
+#include "pg_prepared.hpp"
+
+pg_prepared::pg_prepared(const std::string& name, const std::string& sql, const std::vector<Oid>& param_types) :
+	_name(name), _sql(sql), _param_types(param_types) {}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "libpq-fe.h"
+
+// A statement registered on the pool with async_pg::prepare.
+// Every connection prepares it while connecting, before it takes queries.
+// An empty param_types lets the server infer the types of the parameters.
+class pg_prepared {
+public:
+	pg_prepared(const std::string& name, const std::string& sql, const std::vector<Oid>& param_types = {});
+
+	const std::string& name() const { return _name; }
+	const std::string& sql() const { return _sql; }
+	const std::vector<Oid>& param_types() const { return _param_types; }
+
+private:
+	std::string _name;
+	std::string _sql;
+	std::vector<Oid> _param_types;
+};
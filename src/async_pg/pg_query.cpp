@@ -1,4 +1,5 @@
 #include "pg_query.hpp"
+#include <stdexcept>
 
 pg_query::pg_query() {}
 
@@ -18,32 +19,81 @@ pg_query::pg_query(const std::string& name, const std::string& sql, const std::l
 pg_query::pg_query(std::string&& name, std::string&& sql, std::list<pg_param>&& params) :
 	_name(name), _sql(sql), _params(params) {}
 
-pg_query::~pg_query() {}
+pg_query::pg_query(std::vector<pg_statement>&& batch, bool transaction) :
+	_batch(std::move(batch)), _transaction(transaction) {}
 
-pg_query::pg_query(pg_query&& o) {
-	*this = std::move(o);
-}
-
-pg_query& pg_query::operator=(pg_query&& o) {
-	_name = std::move(o._name);
-	_sql = std::move(o._sql);
-	_params = std::move(o._params);
-	_promise = std::move(o._promise);
-	return *this;
+pg_query::~pg_query() {
+	// a query dropped without completion, e.g. never started, still reports to its caller
+	if (_callback) {
+		complete(std::make_exception_ptr(std::runtime_error("query abandoned")), {});
+	}
 }
 
 void pg_query::set_result(std::list<pg_result>&& result) {
-	_promise.set_value(std::move(result));
+	if (!_timed_out) {
+		complete(nullptr, std::move(result));
+	}
 }
 
 void pg_query::set_error(const std::string& error) {
-	_promise.set_exception(std::make_exception_ptr(std::runtime_error(error)));
+	if (!_timed_out) {
+		complete(std::make_exception_ptr(std::runtime_error(error)), {});
+	}
 }
 
 void pg_query::set_error(std::string&& error) {
-	_promise.set_exception(std::make_exception_ptr(std::runtime_error(std::move(error))));
+	if (!_timed_out) {
+		complete(std::make_exception_ptr(std::runtime_error(std::move(error))), {});
+	}
+}
+
+void pg_query::set_exception(std::exception_ptr error) {
+	if (!_timed_out) {
+		complete(error, {});
+	}
+}
+
+void pg_query::complete(std::exception_ptr error, std::list<pg_result>&& results) {
+	if (!_callback) {
+		return;
+	}
+	pg_completion completion(std::move(_callback), error, std::move(results));
+	if (_executor) {
+		_executor->post(std::move(completion));
+	}
+	else {
+		completion.run();
+	}
+}
+
+void pg_query::set_timeout(std::chrono::milliseconds timeout) {
+	_deadline = std::chrono::steady_clock::now() + timeout;
+}
+
+void pg_query::time_out() {
+	if (!_timed_out) {
+		set_error("query timeout");
+		_timed_out = true;
+	}
 }
 
 std::future<std::list<pg_result>> pg_query::get_future() {
-	return _promise.get_future();
+	// the promise lives in the callback storage, only futures pay for its shared state
+	std::promise<std::list<pg_result>> promise;
+	auto future = promise.get_future();
+	_callback = [promise = std::move(promise)](std::exception_ptr error, std::list<pg_result>&& results) mutable {
+		if (error) {
+			promise.set_exception(error);
+		}
+		else {
+			promise.set_value(std::move(results));
+		}
+	};
+	_executor = nullptr;
+	return future;
+}
+
+void pg_query::set_callback(pg_callback&& callback, pg_executor* executor) {
+	_callback = std::move(callback);
+	_executor = executor;
 }
\ No newline at end of file
@@ -1,11 +1,21 @@
 #pragma once
 
+#include <chrono>
 #include <future>
 #include <string>
 #include <list>
+#include <memory>
+#include <vector>
+#include "pg_callback.hpp"
+#include "pg_executor.hpp"
 #include "pg_param.hpp"
 #include "pg_result.hpp"
+#include "pg_statement.hpp"
+#include "pg_timer_wheel.hpp"
 
+class pg_copy_sink;
+class pg_copy_state;
+class pg_stream;
 
 class pg_query {
 public:
@@ -16,27 +26,96 @@ public:
 	pg_query(std::string&& sql, std::list<pg_param>&& params);
 	pg_query(const std::string& name, const std::string& sql, const std::list<pg_param>& params);
 	pg_query(std::string&& name, std::string&& sql, std::list<pg_param>&& params);
+	pg_query(std::vector<pg_statement>&& batch, bool transaction);
 	~pg_query();
 
+	// linked in the submission queue and armed in a timer wheel by address
 	pg_query(const pg_query&) = delete;
 	pg_query& operator=(const pg_query&) = delete;
-
-	pg_query(pg_query&&);
-	pg_query& operator=(pg_query&&);
+	pg_query(pg_query&&) = delete;
+	pg_query& operator=(pg_query&&) = delete;
 
 	void set_result(std::list<pg_result>&& result);
 	void set_error(const std::string& error);
 	void set_error(std::string&& error);
+	void set_exception(std::exception_ptr error);
 
 	const std::string& name() { return _name; }
 	const std::string& sql() { return _sql; }
 	const std::list<pg_param>& params() { return _params; }
+	const std::vector<pg_statement>& batch() { return _batch; }
+	bool is_batch() const { return _batch.size() > 0; }
+	bool transaction() const { return _transaction; }
 
+	// A query completes either through the future or through the callback, called on the reactor thread
+	// or posted to executor. Only one of them may be set.
 	std::future<std::list<pg_result>> get_future();
+	void set_callback(pg_callback&& callback, pg_executor* executor = nullptr);
+
+	// Deadline of the query, none by default. A query that times out fails with "query timeout",
+	// later results and errors are ignored.
+	void set_timeout(std::chrono::milliseconds timeout);
+	bool has_deadline() const { return _deadline != std::chrono::steady_clock::time_point::max(); }
+	std::chrono::steady_clock::time_point deadline() const { return _deadline; }
+	void time_out();
+	bool timed_out() const { return _timed_out; }
+
+	std::chrono::steady_clock::time_point submitted() const { return _submitted; }
+
+	// An idempotent query in flight on a lost connection is sent again on another one,
+	// see pg_pool_options::max_replays
+	void set_idempotent(bool idempotent) { _idempotent = idempotent; }
+	bool idempotent() const { return _idempotent; }
+	int replays() const { return _replays; }
+	void replay() { ++_replays; }
+
+	// format of the result values, text by default, see pg_format
+	void set_format(pg_format format) { _format = format; }
+	pg_format format() const { return _format; }
+
+	// rows are delivered to the stream while the query runs, see async_pg::stream
+	void set_stream(std::shared_ptr<pg_stream> stream) { _stream = std::move(stream); }
+	pg_stream* stream() const { return _stream.get(); }
+
+	// a COPY FROM STDIN sending the data of its writer, see async_pg::copy_in
+	void set_copy(std::shared_ptr<pg_copy_state> copy) { _copy = std::move(copy); }
+	pg_copy_state* copy() const { return _copy.get(); }
+
+	// a COPY TO STDOUT handing its rows to sink, see async_pg::copy_out
+	void set_sink(pg_copy_sink* sink) { _sink = sink; }
+	pg_copy_sink* sink() const { return _sink; }
+
+	// streams and copies run alone on their connection
+	bool exclusive() const { return _stream || _copy || _sink; }
+
+	pg_timer& timer() { return _timer; }
+	int slot() const { return _slot; }
+	void set_slot(int slot) { _slot = slot; }
+
+	pg_query* next() const { return _next; }
 
 private:
+	friend class pg_submit_queue;
+
+	void complete(std::exception_ptr error, std::list<pg_result>&& results);
+
 	std::string _name;
 	std::string _sql;
 	std::list<pg_param> _params;
-	std::promise<std::list<pg_result>> _promise;
+	std::vector<pg_statement> _batch;
+	bool _transaction = false;
+	pg_callback _callback{ nullptr };	// emptied once called
+	pg_executor* _executor = nullptr;
+	pg_query* _next = nullptr;	// intrusive link, owned by pg_submit_queue
+	std::chrono::steady_clock::time_point _submitted = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point _deadline = std::chrono::steady_clock::time_point::max();
+	bool _timed_out = false;
+	bool _idempotent = false;
+	int _replays = 0;
+	pg_format _format = pg_format::text;
+	std::shared_ptr<pg_stream> _stream;
+	std::shared_ptr<pg_copy_state> _copy;
+	pg_copy_sink* _sink = nullptr;
+	pg_timer _timer{ this };	// armed in the timer wheel of the reactor holding the query
+	int _slot = -1;				// reactor slot the query was sent on, -1 while queued
 };
\ No newline at end of file
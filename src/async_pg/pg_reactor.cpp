@@ -0,0 +1,1536 @@
+#include "pg_reactor.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "pg_completion_queue.hpp"
+#include "pg_connection.hpp"
+#include "pg_connection_error.hpp"
+#include "pg_log.hpp"
+
+
+// Rules:
+// 1. Don't call PQconsumeInput on PGRES_POLLING_READING.
+//		If you call PQconsumeInput on PGRES_POLLING_READING, 
+//		you will stuck in receiving PGRES_POLLING_READING for PQconnectStatus
+// 2. You shouldn't call PQflush on PGRES_POLLING_WRITING as well.
+//		Of course, there were no problem when I call PQflush, but, 
+//		to respect 1st rule don't call PQflush.
+// 3. After PQconnectStart, you MUST always call PQconnectStatus, 
+//		until it returns PGRES_POLLING_OK or PGRES_POLLING_FAILED.
+//		First time call PQconnectStatus, it returns PGRES_POLLING_WRITING.
+//		You need to wait until socket will be writable.
+//		On next call, PQconnectStatus returns PGRES_POLLING_READING.
+//		It doesn't matter how much time passed between PQconnectStart and PQconnectStatus.
+//		Even if I put sleep between calls to PQconnectStatus, the return value order is the same
+//
+// 4. You cannot know if connection failed after success connect. 
+//		You can know it only when you try to send some command to that connection.
+//		Otherwise, you will always get PGRES_POLLING_OK.
+// 5. Call PQgetResult until it returns nullptr. Even if you that only one result will return, 
+//		call it until it returns nullptr. If you don't do that, next PQsendQuery call returns FALSE.
+// 6. If PQisBusy returns TRUE, wait for read- and write- ready
+
+pg_reactor::pg_reactor(int id, const std::map<std::string, std::string>& connection_params, pg_admission& admission, pg_readiness& readiness) :
+	_id(id),
+	_connection_params(connection_params),
+	_admission(admission),
+	_readiness(readiness),
+	_running(false),
+	_parked(false),
+	_event_fd(-1),
+	_efd(-1),
+	_min_connections(0),
+	_active(0),
+	_busy_ticks(0),
+	_rng(std::random_device()()),
+	_shedding(false),
+	_shed_count(0),
+	_registry_changed(false),
+	_resumed(false),
+	_overflow_size(0),
+	_idle_connections(0),
+	_queries_completed(0),
+	_queries_stolen(0),
+	_queries_timed_out(0),
+	_queries_cancelled(0),
+	_queries_shed(0),
+	_queries_replayed(0),
+	_queries_aborted(0),
+	_rows_streamed(0),
+	_streams_paused(0),
+	_copy_bytes(0),
+	_connections(0),
+	_connections_grown(0),
+	_connections_retired(0),
+	_connections_recycled(0),
+	_keepalive_probes(0),
+	_epoll_wait_calls(0),
+	_epoll_ctl_calls(0),
+	_wakeups(0),
+	_prepared_hits(0),
+	_prepared_misses(0)
+{
+	_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_event_fd == -1) {
+		std::string error = strerror(errno);
+		throw std::runtime_error("eventfd() failed: " + error);
+	}
+}
+
+pg_reactor::~pg_reactor() {
+	request_stop();
+	join();
+
+	if (_event_fd != -1) {
+		close(_event_fd);
+	}
+}
+
+void pg_reactor::set_siblings(std::vector<pg_reactor*> siblings) {
+	_siblings = std::move(siblings);
+}
+
+void pg_reactor::start(int first_connection_id, int n_connections, int max_connections, const pg_pool_options& options, int cpu) {
+	_options = options;
+	_running = true;
+	_thr = std::thread(&pg_reactor::process, this, first_connection_id, n_connections, max_connections, cpu);
+}
+
+void pg_reactor::request_stop() {
+	if (_running.exchange(false)) {
+		cond_notify();
+	}
+}
+
+void pg_reactor::join() {
+	if (_thr.joinable()) {
+		_thr.join();
+	}
+}
+
+void pg_reactor::set_registry(std::shared_ptr<const std::vector<pg_prepared>> registry) {
+	{
+		std::lock_guard<std::mutex> lock(_registry_mtx);
+		_next_registry = std::move(registry);
+	}
+	_registry_changed.store(true);
+	wake();
+}
+
+void pg_reactor::submit(pg_query* query) {
+	_submissions.push(query);
+	wake();
+}
+
+void pg_reactor::drain(pg_submit_queue& queue) {
+	{
+		std::lock_guard<std::mutex> lock(_overflow_mtx);
+		for (auto& query : _overflow) {
+			query->timer().cancel();
+			queue.push(query.release());
+		}
+		_overflow.clear();
+		_overflow_size = 0;
+	}
+	for (pg_query* q = _submissions.pop_all(); q;) {
+		pg_query* next = q->next();
+		queue.push(q);
+		q = next;
+	}
+}
+
+void pg_reactor::resume() {
+	_resumed.store(true);
+	wake();
+}
+
+void pg_reactor::add_stats(pg_stats& s) const {
+	s.queries_completed += _queries_completed.load(std::memory_order_relaxed);
+	s.queries_stolen += _queries_stolen.load(std::memory_order_relaxed);
+	s.queries_timed_out += _queries_timed_out.load(std::memory_order_relaxed);
+	s.queries_cancelled += _queries_cancelled.load(std::memory_order_relaxed);
+	s.queries_shed += _queries_shed.load(std::memory_order_relaxed);
+	s.queries_replayed += _queries_replayed.load(std::memory_order_relaxed);
+	s.queries_aborted += _queries_aborted.load(std::memory_order_relaxed);
+	s.rows_streamed += _rows_streamed.load(std::memory_order_relaxed);
+	s.streams_paused += _streams_paused.load(std::memory_order_relaxed);
+	s.copy_bytes += _copy_bytes.load(std::memory_order_relaxed);
+	s.connections += _connections.load(std::memory_order_relaxed);
+	s.connections_grown += _connections_grown.load(std::memory_order_relaxed);
+	s.connections_retired += _connections_retired.load(std::memory_order_relaxed);
+	s.connections_recycled += _connections_recycled.load(std::memory_order_relaxed);
+	s.keepalive_probes += _keepalive_probes.load(std::memory_order_relaxed);
+	s.epoll_wait_calls += _epoll_wait_calls.load(std::memory_order_relaxed);
+	s.epoll_ctl_calls += _epoll_ctl_calls.load(std::memory_order_relaxed);
+	s.wakeups += _wakeups.load(std::memory_order_relaxed);
+	s.prepared_hits += _prepared_hits.load(std::memory_order_relaxed);
+	s.prepared_misses += _prepared_misses.load(std::memory_order_relaxed);
+}
+
+void pg_reactor::process(int first_connection_id, int n_connections, int max_connections, int cpu) {
+
+	if (cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		int r = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if (r != 0) {
+			log_error("\treactor %d: pthread_setaffinity_np(%d) -> %d", _id, cpu, r);
+		}
+	}
+
+	if (!setup(first_connection_id, n_connections, max_connections)) {
+		return;
+	}
+	pg_completion_queue::hold_wakeups(true);
+	while (_running.load(std::memory_order_acquire)) {
+		prepare();
+		poll(-1);
+	}
+	teardown();
+	pg_completion_queue::hold_wakeups(false);
+}
+
+bool pg_reactor::start_embedded(int first_connection_id, int n_connections, int max_connections, const pg_pool_options& options) {
+	_options = options;
+	_running = true;
+	if (!setup(first_connection_id, n_connections, max_connections)) {
+		_running = false;
+		return false;
+	}
+	// parked between run_once calls, so that producers make fd() readable
+	prepare();
+	_parked.store(true);
+	return true;
+}
+
+int pg_reactor::timeout() {
+	if (_efd == -1) {
+		return -1;
+	}
+	return _submissions.empty() && !_registry_changed.load() ? next_timeout() : 0;
+}
+
+void pg_reactor::run_once(int timeout_ms) {
+	if (_efd == -1 || !_running.load(std::memory_order_acquire)) {
+		return;
+	}
+	// the loop rotated: what poll collects is dispatched before returning to the caller's loop
+	_parked.store(false);
+	pg_completion_queue::hold_wakeups(true);
+	poll(timeout_ms);
+	prepare();
+	pg_completion_queue::hold_wakeups(false);
+
+	// a query submitted after the wait in poll would not wake the caller's loop otherwise
+	_parked.store(true);
+	if (!_submissions.empty() || _registry_changed.load()) {
+		wake();
+	}
+}
+
+void pg_reactor::stop_embedded() {
+	if (_running.exchange(false) && _efd != -1) {
+		teardown();
+	}
+	_parked.store(false);
+}
+
+bool pg_reactor::setup(int first_connection_id, int n_connections, int max_connections) {
+	// The slot array is never resized while the loop runs, epoll_event.data.ptr points into it.
+	// Slots above n_connections are spare until the pool grows.
+	_slots.clear();
+	_slots.resize(max_connections);
+	_idle.clear();
+	_idle.reserve(max_connections);
+	_open.clear();
+	_dirty.clear();
+	_dirty.reserve(max_connections);
+	_min_connections = n_connections;
+	// libpq resolves the host on every attempt, so reconnects follow DNS changes and try every address
+	_connect_params = _connection_params;
+	if (_options.tcp_keepalive_s > 0) {
+		std::string s = std::to_string(_options.tcp_keepalive_s);
+		_connect_params.emplace("keepalives", "1");
+		_connect_params.emplace("keepalives_idle", s);
+		_connect_params.emplace("keepalives_interval", s);
+		_connect_params.emplace("keepalives_count", "3");
+	}
+	_active = 0;
+	_busy_ticks = 0;
+
+	// Connections that fail to start, e.g. while the host does not resolve, stay in the pool
+	// as failed and are retried with backoff like connections lost later.
+	for (int i = 0; i < max_connections; ++i) {
+		slot& s = _slots[i];
+		s.conn.reset(new pg_connection(first_connection_id + i, _options.pipeline_depth));
+		if (i >= n_connections) {
+			continue;
+		}
+		s.active = true;
+		++_active;
+		if (!s.conn->start_connect(_connect_params)) {
+			log_error("\t[%02d] start_connect -> %s", s.conn->id(), s.conn->last_error().c_str());
+		}
+		mark_dirty(s);
+	}
+	_connections.store(_active, std::memory_order_relaxed);
+
+	_efd = epoll_create1(0);
+	if (_efd == -1) {
+		std::string error = strerror(errno);
+		log_error("reactor %d: epoll_create1 -> %s", _id, error.c_str());
+		_readiness.abandon("epoll_create1() failed: " + error);
+		_slots.clear();
+		return false;
+	}
+
+	{
+		// _event_fd is the only descriptor registered without data.ptr
+		epoll_event e;
+		e.events = EPOLLIN;
+		e.data.ptr = nullptr;
+		if (epoll_ctl(_efd, EPOLL_CTL_ADD, _event_fd, &e) == -1) {
+			log_error("failed to add _event_fd to epoll");
+			_readiness.abandon("failed to add _event_fd to epoll");
+			close(_efd);
+			_efd = -1;
+			_slots.clear();
+			return false;
+		}
+	}
+
+	_events.resize(max_connections + 1);
+	_advancing.reserve(max_connections);
+	return true;
+}
+
+void pg_reactor::prepare() {
+
+	// take queries from overflow queues, own first, if there are more idle connections than local queries
+	if (_idle.size() > _queries.size()) {
+		std::size_t want = _idle.size() - _queries.size();
+		want -= steal(_taken, want);
+		for (pg_reactor* sibling : _siblings) {
+			if (!want) {
+				break;
+			}
+			std::size_t n = sibling->steal(_taken, want);
+			_queries_stolen.fetch_add(n, std::memory_order_relaxed);
+			want -= n;
+		}
+		// spilled queries were the oldest of their reactor, they go before the local ones
+		while (_taken.size()) {
+			arm(*_taken.back());
+			_queries.push_front(std::move(_taken.back()));
+			_taken.pop_back();
+		}
+	}
+
+	// connections prepare statements registered meanwhile once they are idle
+	if (_registry_changed.load() && _registry_changed.exchange(false)) {
+		{
+			std::lock_guard<std::mutex> lock(_registry_mtx);
+			_registry = _next_registry;
+		}
+		for (slot& s : _slots) {
+			mark_dirty(s);
+		}
+	}
+
+	// connections stopped by a full stream are read again once its consumer took rows,
+	// copies send what their producer wrote meanwhile
+	if (_resumed.load() && _resumed.exchange(false)) {
+		unpause();
+	}
+
+	// advance connections whose state might have changed
+	_advancing.swap(_dirty);
+	for (slot* s : _advancing) {
+		s->dirty = false;
+		advance(*s);
+	}
+	_advancing.clear();
+
+	dispatch();
+
+	if (_queries.size() && _idle.empty()) {
+		spill(_queries);
+	}
+
+	// the pool size is checked periodically while it can change
+	if ((int)_slots.size() > _min_connections && !_resize_timer.armed() && (_active > _min_connections || _queries.size())) {
+		_timers.schedule(_resize_timer, std::chrono::steady_clock::now() + std::chrono::milliseconds(100));
+	}
+	if ((_options.keepalive_ms > 0 || _options.max_lifetime_ms > 0) && !_maintenance_timer.armed()) {
+		int period = _options.keepalive_ms > 0 ? std::min(_options.keepalive_ms, 1000) : 1000;
+		_timers.schedule(_maintenance_timer, std::chrono::steady_clock::now() + std::chrono::milliseconds(period));
+	}
+}
+
+void pg_reactor::poll(int max_timeout) {
+
+	// completions of the previous pass wake their workers before the reactor blocks
+	pg_completion_queue::flush_wakeups();
+
+	// wait for events
+	// Producers signal _event_fd only while _parked is set. Publishing _parked before checking
+	// the submission queue guarantees that either the reactor sees a new query here
+	// or its producer sees _parked and wakes the reactor up.
+	_idle_connections.store((int)_idle.size(), std::memory_order_relaxed);
+	_parked.store(true);
+	int timeout = _submissions.empty() && !_registry_changed.load() && !_resumed.load() && !stealable() ? next_timeout() : 0;
+	if (max_timeout >= 0 && (timeout < 0 || timeout > max_timeout)) {
+		timeout = max_timeout;
+	}
+	int n_events = epoll_wait(_efd, _events.data(), (int)_events.size(), timeout);
+	_parked.store(false);
+	_epoll_wait_calls.fetch_add(1, std::memory_order_relaxed);
+	if (n_events == -1) {
+		log_error("epoll_wait -> %d", errno);
+	}
+
+	// read events
+	for (int i = 0; i < n_events; ++i) {
+		if (_events[i].data.ptr == nullptr) {
+			cond_reset();
+		}
+		else {
+			handle_event(*static_cast<slot*>(_events[i].data.ptr), _events[i].events);
+		}
+	}
+
+	// get new requests
+	for (pg_query* q = _submissions.pop_all(); q;) {
+		pg_query* next = q->next();
+		arm(*q);
+		_queries.emplace_back(q);
+		q = next;
+	}
+
+	// expire deadlines
+	auto now = std::chrono::steady_clock::now();
+	_timers.advance(now, _expired);
+	for (pg_timer* t : _expired) {
+		if (t == &_resize_timer) {
+			resize();
+		}
+		else if (t == &_reconnect_timer) {
+			reconnect();
+		}
+		else if (t == &_maintenance_timer) {
+			maintain();
+		}
+		else {
+			expire(*static_cast<pg_query*>(t->owner()));
+		}
+	}
+	_expired.clear();
+	expire_overflow(now);
+	pg_completion_queue::flush_wakeups();
+}
+
+void pg_reactor::teardown() {
+
+	_idle_connections.store(0, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(_overflow_mtx);
+		for (auto& query : _overflow) {
+			_queries.push_back(std::move(query));
+		}
+		_overflow.clear();
+		_overflow_size = 0;
+		_overflow_deadline = std::chrono::steady_clock::time_point::max();
+	}
+
+	for (pg_query* q = _submissions.pop_all(); q;) {
+		pg_query* next = q->next();
+		_queries.emplace_back(q);
+		q = next;
+	}
+
+	for (auto& s : _slots) {
+		for (auto& query : s.queries) {
+			if (query) {
+				query->set_error("stopping service");
+			}
+		}
+	}
+
+	for (auto& query : _queries) {
+		query->set_error("stopping service");
+	}
+	for (auto& w : _affinity) {
+		w.query->set_error("stopping service");
+	}
+	_admission.release(_queries.size() + _affinity.size());
+	_queries.clear();
+	_affinity.clear();
+	set_shedding(false);
+	_resize_timer.cancel();
+	_reconnect_timer.cancel();
+	_maintenance_timer.cancel();
+	_connections.store(0, std::memory_order_relaxed);
+	_holders.clear();
+
+	close(_efd);
+	_efd = -1;
+	_slots.clear();
+	_idle.clear();
+	_open.clear();
+	_dirty.clear();
+}
+
+void pg_reactor::advance(slot& s) {
+
+	pg_connection* conn = s.conn.get();
+	if (!s.active) {
+		return;
+	}
+
+	if (s.queries.size() && (conn->async_state() == pg_connection::async_state_t::connection_failed
+		|| conn->async_state() == pg_connection::async_state_t::connection_abort)) {
+		replay(s);
+	}
+
+	if (conn->async_state() == pg_connection::async_state_t::connection_failed) {
+		if (!backoff(s)) {
+			return;
+		}
+		log_info("[%02d] async_state_t::connection_failed: %s", conn->id(), conn->last_error().c_str());
+		forget(s);
+		if (!conn->start_connect(_connect_params)) {
+			log_error("\t[%02d] start_connect -> %s", conn->id(), conn->last_error().c_str());
+			mark_dirty(s);	// waits for the next attempt
+			return;
+		}
+	}
+
+	if (conn->async_state() == pg_connection::async_state_t::connection_abort) {
+		if (!backoff(s)) {
+			return;
+		}
+		log_info("[%02d] async_state_t::connection_abort: %s", conn->id(), conn->last_error().c_str());
+		forget(s);
+		if (!conn->start_reset()) {
+			log_error("\t[%02d] start_reset -> %s", conn->id(), conn->last_error().c_str());
+			mark_dirty(s);	// waits for the next attempt
+			return;
+		}
+	}
+
+	uint32_t interest = 0;
+
+	// conn->connectPoll() might change async_state of connection
+	if (conn->async_state() == pg_connection::async_state_t::connecting) {
+		log_info("[%02d] async_state_t::connecting", conn->id());
+		s.prepared = 0;
+		PostgresPollingStatusType st = conn->connectPoll();
+		if (st == PostgresPollingStatusType::PGRES_POLLING_READING) {
+			interest |= EPOLLIN;
+		}
+		else if (st == PostgresPollingStatusType::PGRES_POLLING_WRITING) {
+			interest |= EPOLLOUT;
+		}
+	}
+
+	// conn->resetPoll() might change async_state of connection
+	if (conn->async_state() == pg_connection::async_state_t::resetting) {
+		log_info("[%02d] async_state_t::resetting", conn->id());
+		s.prepared = 0;
+		PostgresPollingStatusType st = conn->resetPoll();
+		if (st == PostgresPollingStatusType::PGRES_POLLING_READING) {
+			interest |= EPOLLIN;
+		}
+		else if (st == PostgresPollingStatusType::PGRES_POLLING_WRITING) {
+			interest |= EPOLLOUT;
+		}
+	}
+
+	if (conn->async_state() == pg_connection::async_state_t::connection_failed
+		|| conn->async_state() == pg_connection::async_state_t::connection_abort) {
+		mark_dirty(s);
+		return;
+	}
+
+	// a new or reset connection prepares the registered statements before it is marked idle
+	if (conn->async_state() == pg_connection::async_state_t::idle && _registry && s.prepared < _registry->size()) {
+		warm_up(s);
+	}
+
+	if (conn->async_state() == pg_connection::async_state_t::executing_query && conn->copying()) {
+		copy_in(s);
+	}
+
+	if (conn->async_state() == pg_connection::async_state_t::executing_query) {
+		// PQisBusy is false during a copy, which is read too: rows come or the server may end it with an error
+		if ((conn->poll_read() || conn->copying() || conn->copying_out()) && !s.paused) {
+			interest |= EPOLLIN;
+		}
+		if (conn->poll_write()) {
+			interest |= EPOLLOUT;
+		}
+		if (!s.open && !s.exclusive && conn->can_send()) {
+			s.open = true;
+			_open.push_back(&s);
+		}
+	}
+	else if (conn->async_state() == pg_connection::async_state_t::idle) {
+		// idle connections keep read interest, so that notices and a closed socket are consumed
+		// instead of reporting EPOLLHUP forever
+		interest |= EPOLLIN;
+		if (!s.idle && s.queries.empty()) {
+			s.idle = true;
+			if (!s.probing) {
+				s.idle_since = std::chrono::steady_clock::now();
+			}
+			_idle.push_back(&s);
+		}
+		if (s.queries.empty()) {
+			s.probing = false;
+		}
+		if (!s.up && s.queries.empty()) {
+			s.up = true;
+			s.backoff_ms = 0;
+			s.retry_at = {};
+			if (_options.max_lifetime_ms > 0) {
+				int lifetime = _options.max_lifetime_ms - (int)(_rng() % (uint32_t)(_options.max_lifetime_ms / 10 + 1));
+				s.recycle_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(lifetime);
+			}
+			if (!s.reported) {
+				s.reported = true;
+				_readiness.connected();
+			}
+		}
+	}
+
+	watch(s, interest);
+}
+
+void pg_reactor::dispatch() {
+
+	auto now = std::chrono::steady_clock::now();
+	std::size_t dequeued = 0;
+
+	// queries waiting for a connection that holds their statement, sent elsewhere once the wait budget is over
+	for (std::size_t i = 0; i < _affinity.size();) {
+		if (expire_queued(*_affinity[i].query, now)) {
+			_affinity.erase(_affinity.begin() + i);
+			++dequeued;
+			continue;
+		}
+		bool held = false;
+		slot* s = find_holder(_affinity[i].query->name(), held);
+		if (!s && (!held || _affinity[i].deadline <= now)) {
+			s = pop_ready();
+		}
+		if (!s) {
+			++i;
+			continue;
+		}
+		std::unique_ptr<pg_query> query = std::move(_affinity[i].query);
+		_affinity.erase(_affinity.begin() + i);
+		if (!send(*s, query)) {
+			break;
+		}
+		++dequeued;
+	}
+
+	// A connection takes one query per round, so idle connections are preferred over pipelining.
+	// A statement used for the first time on a connection is prepared and executed in one command,
+	// the queries behind it are dispatched meanwhile.
+	while (_queries.size()) {
+
+		pg_query& query = *_queries.front();
+		if (expire_queued(query, now)) {
+			_queries.pop_front();
+			++dequeued;
+			continue;
+		}
+		if (shed(query, now)) {
+			// counted before its caller can see it, like completed queries
+			_queries_shed.fetch_add(1, std::memory_order_relaxed);
+			query.set_error("overloaded");
+			_queries.pop_front();
+			++dequeued;
+			continue;
+		}
+		// streams and copies need a connection with nothing in flight, see pg_connection::start_send_query
+		slot* s = nullptr;
+		if (!query.is_batch() && !query.name().empty() && !query.exclusive()) {
+			bool held = false;
+			s = find_holder(query.name(), held);
+			if (!s && held && _options.affinity_wait_us > 0) {
+				auto deadline = now + std::chrono::microseconds(_options.affinity_wait_us);
+				_affinity.push_back(affinity_wait{ std::move(_queries.front()), deadline });
+				_queries.pop_front();
+				continue;
+			}
+		}
+
+		if (!s) {
+			s = query.exclusive() ? pop_idle() : pop_ready();
+		}
+		if (!s) {
+			break;
+		}
+
+		std::unique_ptr<pg_query> next = std::move(_queries.front());
+		_queries.pop_front();
+		if (!send(*s, next)) {
+			break;
+		}
+		++dequeued;
+	}
+
+	// nothing left to measure the wait on
+	if (_queries.empty()) {
+		_shed_first_above = {};
+		set_shedding(false);
+	}
+	_admission.release(dequeued);
+}
+
+bool pg_reactor::shed(pg_query& query, std::chrono::steady_clock::time_point now) {
+
+	if (_options.shed_target_ms <= 0) {
+		return false;
+	}
+	auto target = std::chrono::milliseconds(_options.shed_target_ms);
+	std::chrono::duration<double, std::milli> interval(_options.shed_interval_ms);
+
+	// CoDel: the queue is overloaded once the wait stayed above target for a whole interval.
+	// Queries are then dropped at a rate growing with the square root of the drops so far,
+	// until one is taken with a wait below target.
+	if (now - query.submitted() < target) {
+		_shed_first_above = {};
+		set_shedding(false);
+		return false;
+	}
+
+	if (_shed_first_above == std::chrono::steady_clock::time_point{}) {
+		_shed_first_above = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+		return false;
+	}
+
+	if (!_shedding) {
+		if (now < _shed_first_above) {
+			return false;
+		}
+		// an overload shortly after the previous one resumes near its drop rate
+		_shed_count = _shed_count > 2 && now - _shed_next < 16 * interval ? _shed_count - 2 : 1;
+		_shed_next = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval / std::sqrt((double)_shed_count));
+		set_shedding(true);
+		return true;
+	}
+
+	if (now < _shed_next) {
+		return false;
+	}
+	++_shed_count;
+	_shed_next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval / std::sqrt((double)_shed_count));
+	return true;
+}
+
+void pg_reactor::resize() {
+
+	auto now = std::chrono::steady_clock::now();
+	int max_connections = (int)_slots.size();
+
+	// grow while queries wait too long or no connection has been idle for two checks in a row,
+	// one connection at a time, the others keep running while it connects
+	bool waiting = _queries.size() && now - _queries.front()->submitted() >= std::chrono::milliseconds(_options.grow_wait_ms);
+	_busy_ticks = _queries.size() && _idle.empty() ? _busy_ticks + 1 : 0;
+	if ((waiting || _busy_ticks >= 2) && _active < max_connections) {
+		slot* spare = nullptr;
+		for (slot& s : _slots) {
+			if (s.active && s.conn->async_state() == pg_connection::async_state_t::connecting) {
+				return;
+			}
+			if (!s.active && !spare) {
+				spare = &s;
+			}
+		}
+		open(*spare);
+		return;
+	}
+
+	// shrink by the connection idle for the longest time once it is past the cool-down
+	if (_active > _min_connections) {
+		slot* oldest = nullptr;
+		for (slot& s : _slots) {
+			if (s.active && s.conn->async_state() == pg_connection::async_state_t::idle && s.queries.empty()
+				&& (!oldest || s.idle_since < oldest->idle_since)) {
+				oldest = &s;
+			}
+		}
+		if (oldest && now - oldest->idle_since >= std::chrono::milliseconds(_options.idle_timeout_ms)) {
+			retire(*oldest);
+		}
+	}
+}
+
+void pg_reactor::open(slot& s) {
+	log_info("[%02d] growing the pool", s.conn->id());
+	s.active = true;
+	++_active;
+	_connections.store(_active, std::memory_order_relaxed);
+	_connections_grown.fetch_add(1, std::memory_order_relaxed);
+	if (!s.conn->start_connect(_connect_params)) {
+		log_error("\t[%02d] start_connect -> %s", s.conn->id(), s.conn->last_error().c_str());
+	}
+	mark_dirty(s);
+}
+
+void pg_reactor::retire(slot& s) {
+	// the socket leaves the epoll set when PQfinish closes it,
+	// the stale _idle entry and the statement holders are dropped lazily
+	log_info("[%02d] retiring idle connection", s.conn->id());
+	s.conn->close();
+	s.active = false;
+	forget(s);
+	--_active;
+	_connections.store(_active, std::memory_order_relaxed);
+	_connections_retired.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool pg_reactor::backoff(slot& s) {
+
+	// the first attempt after a connection was lost is immediate, the next ones wait
+	// for an exponential delay randomized between half and all of it, so that connections
+	// of every client do not reconnect in lockstep to a recovering server
+	auto now = std::chrono::steady_clock::now();
+	s.up = false;
+	if (now < s.retry_at) {
+		retry_later(s.retry_at);
+		return false;
+	}
+
+	s.backoff_ms = s.backoff_ms ? std::min(s.backoff_ms * 2, _options.reconnect_max_ms) : _options.reconnect_min_ms;
+	int delay = s.backoff_ms / 2 + (int)(_rng() % (uint32_t)(s.backoff_ms / 2 + 1));
+	s.retry_at = now + std::chrono::milliseconds(delay);
+	return true;
+}
+
+void pg_reactor::retry_later(std::chrono::steady_clock::time_point when) {
+	if (!_reconnect_timer.armed() || when < _reconnect_at) {
+		_reconnect_at = when;
+		_timers.schedule(_reconnect_timer, when);
+	}
+}
+
+void pg_reactor::reconnect() {
+	// slots not due yet arm the timer again from advance
+	for (slot& s : _slots) {
+		if (s.active && !s.up && (s.conn->async_state() == pg_connection::async_state_t::connection_failed
+			|| s.conn->async_state() == pg_connection::async_state_t::connection_abort)) {
+			mark_dirty(s);
+		}
+	}
+}
+
+void pg_reactor::maintain() {
+
+	// Rule 4: a connection dropped by the server, a proxy or the network is only noticed when something
+	// is sent on it. Idle connections are probed so that this happens here and not on the next query.
+	auto now = std::chrono::steady_clock::now();
+	bool connecting = false;
+	slot* oldest = nullptr;
+	for (slot& s : _slots) {
+		if (!s.active) {
+			continue;
+		}
+		if (!s.up) {
+			connecting = true;
+			continue;
+		}
+		if (s.conn->async_state() != pg_connection::async_state_t::idle || s.queries.size()) {
+			continue;
+		}
+		if (_options.max_lifetime_ms > 0 && s.recycle_at <= now && (!oldest || s.recycle_at < oldest->recycle_at)) {
+			oldest = &s;
+		}
+		else if (_options.keepalive_ms > 0 && now - std::max(s.idle_since, s.probed_at) >= std::chrono::milliseconds(_options.keepalive_ms)) {
+			probe(s);
+		}
+	}
+
+	// replacements are spread out so that the pool never loses more than one connection at once
+	if (oldest && !connecting) {
+		recycle(*oldest);
+	}
+}
+
+void pg_reactor::probe(slot& s) {
+	// the stale _idle entry is skipped while the probe is in flight, like a statement preparation
+	if (!s.conn->start_send_query("")) {
+		log_error("[%02d] keepalive probe -> %s", s.conn->id(), s.conn->last_error().c_str());
+		mark_dirty(s);
+		return;
+	}
+	s.queries.push_back(nullptr);
+	s.probing = true;
+	s.probed_at = std::chrono::steady_clock::now();
+	_keepalive_probes.fetch_add(1, std::memory_order_relaxed);
+	advance(s);
+}
+
+void pg_reactor::recycle(slot& s) {
+	log_info("[%02d] recycling connection past its lifetime", s.conn->id());
+	s.conn->close();
+	forget(s);
+	s.up = false;
+	_connections_recycled.fetch_add(1, std::memory_order_relaxed);
+	if (!s.conn->start_connect(_connect_params)) {
+		log_error("\t[%02d] start_connect -> %s", s.conn->id(), s.conn->last_error().c_str());
+	}
+	mark_dirty(s);
+}
+
+void pg_reactor::set_shedding(bool shedding) {
+	// while any reactor sheds, the pool rejects new queries at submission
+	if (_shedding != shedding) {
+		_shedding = shedding;
+		_admission.set_overloaded(shedding);
+	}
+}
+
+bool pg_reactor::send(slot& s, std::unique_ptr<pg_query>& query) {
+
+	pg_connection* conn = s.conn.get();
+	bool sent = false;
+	if (query->copy() || query->sink()) {
+		sent = conn->start_send_copy(query->sql());
+		if (!sent) {
+			log_error("[%02d] start_send_copy -> %s", conn->id(), conn->last_error().c_str());
+		}
+	}
+	else if (query->is_batch()) {
+		sent = conn->start_send_batch(query->batch(), query->transaction());
+		if (!sent) {
+			log_error("[%02d] start_send_batch -> %s", conn->id(), conn->last_error().c_str());
+		}
+		for (const auto& st : query->batch()) {
+			if (sent && !st.name().empty()) {
+				hold(st.name(), s);
+			}
+		}
+	}
+	else if (query->name().empty()) {
+		sent = conn->start_send_query(query->sql(), query->params(), query->stream() != nullptr, query->format());
+		if (!sent) {
+			log_error("[%02d] start_send_query -> %s", conn->id(), conn->last_error().c_str());
+		}
+	}
+	else if (conn->has_prepared_statement(query->name())) {
+		sent = conn->start_send_prepared_query(query->name(), query->params(), query->stream() != nullptr, query->format());
+		if (!sent) {
+			log_error("[%02d] start_send_prepared_query -> %s", conn->id(), conn->last_error().c_str());
+		}
+		else {
+			_prepared_hits.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	else {
+		sent = conn->start_send_prepare_and_query(query->name(), query->sql(), query->params(), param_types(query->name()), query->format());
+		if (!sent) {
+			log_error("[%02d] start_send_prepare_and_query -> %s", conn->id(), conn->last_error().c_str());
+		}
+		else {
+			hold(query->name(), s);
+			_prepared_misses.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	if (sent) {
+		s.exclusive = query->exclusive();
+		query->set_slot((int)(&s - _slots.data()));
+		s.queries.push_back(std::move(query));
+	}
+	else {
+		// retried at the head of the queue on the next round
+		_queries.push_front(std::move(query));
+	}
+
+	// interest has to be updated before epoll_wait, the request might not be flushed yet
+	advance(s);
+	return sent;
+}
+
+void pg_reactor::warm_up(slot& s) {
+
+	pg_connection* conn = s.conn.get();
+	std::vector<pg_prepared> statements;
+	for (std::size_t i = s.prepared; i < _registry->size(); ++i) {
+		const pg_prepared& st = (*_registry)[i];
+		if (!conn->has_prepared_statement(st.name())) {
+			statements.push_back(st);
+		}
+	}
+	if (statements.empty()) {
+		s.prepared = _registry->size();
+		return;
+	}
+
+	// all Parse messages are written in one flush, failures are logged by complete;
+	// statements that could not be sent are tried again the next time the connection is idle
+	if (!conn->start_send_prepare(statements)) {
+		log_error("[%02d] start_send_prepare -> %s", conn->id(), conn->last_error().c_str());
+		return;
+	}
+	s.prepared = _registry->size();
+	s.queries.push_back(nullptr);
+	for (auto& st : statements) {
+		hold(st.name(), s);
+	}
+}
+
+const std::vector<Oid>& pg_reactor::param_types(const std::string& name) const {
+	static const std::vector<Oid> none;
+	if (_registry) {
+		for (auto& st : *_registry) {
+			if (st.name() == name) {
+				return st.param_types();
+			}
+		}
+	}
+	return none;
+}
+
+void pg_reactor::hold(const std::string& name, slot& s) {
+	std::vector<slot*>& holders = _holders[name];
+	if (std::find(holders.begin(), holders.end(), &s) == holders.end()) {
+		holders.push_back(&s);
+	}
+}
+
+pg_reactor::slot* pg_reactor::find_holder(const std::string& name, bool& held) {
+
+	held = false;
+	auto it = _holders.find(name);
+	if (it == _holders.end()) {
+		return nullptr;
+	}
+
+	// holders that lost the statement on reset are dropped here
+	std::vector<slot*>& holders = it->second;
+	slot* open = nullptr;
+	for (std::size_t i = 0; i < holders.size();) {
+		slot* s = holders[i];
+		if (!s->conn->has_prepared_statement(name)) {
+			holders[i] = holders.back();
+			holders.pop_back();
+			continue;
+		}
+		held = true;
+		// nothing is pipelined behind a stream or a copy
+		if (s->exclusive) {
+			++i;
+			continue;
+		}
+		if (s->conn->async_state() == pg_connection::async_state_t::idle && s->queries.empty()) {
+			return s;
+		}
+		if (!open && s->conn->async_state() == pg_connection::async_state_t::executing_query && s->conn->can_send()) {
+			open = s;
+		}
+		++i;
+	}
+	return open;
+}
+
+void pg_reactor::handle_event(slot& s, uint32_t events) {
+
+	pg_connection* conn = s.conn.get();
+	if (conn->async_state() == pg_connection::async_state_t::executing_query) {
+
+		if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+			conn->read();
+		}
+		if (events & EPOLLOUT) {
+			conn->write();
+		}
+
+		// rows of a streamed query are delivered before its completion,
+		// the data of a COPY TO STDOUT before its result
+		std::list<pg_result> results;
+		std::list<pg_result> rows;
+		while (true) {
+			bool completed = conn->get_results(results, rows);
+			if (rows.size()) {
+				stream(s, std::move(rows));
+				rows.clear();
+			}
+			if (completed) {
+				complete(s, std::move(results));
+				results.clear();
+				continue;
+			}
+			if (conn->copying_out() && !s.paused && copy_out(s)) {
+				continue;
+			}
+			break;
+		}
+	}
+	else if (conn->async_state() == pg_connection::async_state_t::idle) {
+		// unsolicited input: notices, notifications or the server closing the connection
+		conn->read();
+		conn->get_notifies();
+	}
+
+	if (events & EPOLLERR) {
+		log_error("\t[%02d] EPOLLERR", conn->id());
+	}
+
+	mark_dirty(s);
+}
+
+void pg_reactor::complete(slot& s, std::list<pg_result>&& results) {
+
+	// commands complete in the order they were sent, nothing is sent behind a stream or a copy
+	s.exclusive = false;
+	s.paused = false;
+	std::unique_ptr<pg_query> query;
+	if (s.queries.size()) {
+		query = std::move(s.queries.front());
+		s.queries.pop_front();
+	}
+
+	// results of a query that timed out are dropped, its caller got the timeout already
+	if (query) {
+		if (!query->timed_out()) {
+			_queries_completed.fetch_add(1, std::memory_order_relaxed);
+			query->set_result(std::move(results));
+		}
+	}
+	else {
+		for (auto& r : results) {
+			if (r.status() == PGRES_EMPTY_QUERY) {
+				continue;	// keepalive probe
+			}
+			try {
+				r.check();
+			}
+			catch (const std::exception& e) {
+				log_error("%s", e.what());
+			}
+		}
+	}
+
+	// a pipelined query that timed out behind another one is cancelled once it runs
+	if (s.queries.size() && s.queries.front() && s.queries.front()->timed_out()) {
+		cancel_expired(s);
+	}
+}
+
+void pg_reactor::stream(slot& s, std::list<pg_result>&& rows) {
+
+	pg_query* query = s.queries.size() ? s.queries.front().get() : nullptr;
+	pg_stream* stream = query ? query->stream() : nullptr;
+	if (!stream || query->timed_out()) {
+		return;
+	}
+
+	// a stream closed by its consumer is cancelled once, its remaining rows are dropped
+	if (stream->closed()) {
+		if (!stream->_cancelled) {
+			stream->_cancelled = true;
+			cancel(s);
+		}
+		return;
+	}
+
+	std::size_t n = rows.size();
+	if (!stream->push(std::move(rows), this)) {
+		s.paused = true;
+		_streams_paused.fetch_add(1, std::memory_order_relaxed);
+	}
+	_rows_streamed.fetch_add(n, std::memory_order_relaxed);
+}
+
+void pg_reactor::unpause() {
+	for (slot& s : _slots) {
+		if (s.exclusive && s.conn->copying()) {
+			mark_dirty(s);
+		}
+		if (!s.paused) {
+			continue;
+		}
+		pg_query* query = s.queries.size() ? s.queries.front().get() : nullptr;
+		bool waiting = query && ((query->stream() && query->stream()->paused()) || (query->sink() && query->sink()->paused()));
+		if (!waiting) {
+			s.paused = false;
+			mark_dirty(s);
+			// rows of a copy already received are not signalled by the socket again
+			if (s.conn->copying_out()) {
+				handle_event(s, 0);
+			}
+		}
+	}
+}
+
+void pg_reactor::copy_in(slot& s) {
+
+	pg_connection* conn = s.conn.get();
+	pg_query* query = s.queries.size() ? s.queries.front().get() : nullptr;
+	pg_copy_state* writer = query ? query->copy() : nullptr;
+
+	// a copy that timed out ends with an error, the server then copies nothing
+	if (!writer || query->timed_out()) {
+		if (!conn->end_copy(writer ? "query timeout" : "no copy data")) {
+			log_error("[%02d] end_copy -> %s", conn->id(), conn->last_error().c_str());
+		}
+		return;
+	}
+
+	// the next chunk is taken once the previous one is flushed, the socket is the backpressure
+	while (conn->copying() && !conn->poll_write()) {
+		bool end = false;
+		std::string reason;
+		if (!writer->take(_copy_chunk, end, reason, this)) {
+			return;
+		}
+		bool ok = _copy_chunk.empty() || conn->put_copy_data(_copy_chunk);
+		_copy_bytes.fetch_add(_copy_chunk.size(), std::memory_order_relaxed);
+		_copy_chunk.clear();
+		if (!ok) {
+			log_error("[%02d] put_copy_data -> %s", conn->id(), conn->last_error().c_str());
+			return;
+		}
+		if (end && !conn->end_copy(reason)) {
+			log_error("[%02d] end_copy -> %s", conn->id(), conn->last_error().c_str());
+		}
+	}
+}
+
+bool pg_reactor::copy_out(slot& s) {
+
+	// rows go to the sink straight from the libpq buffer,
+	// those of a copy that timed out are dropped until the cancellation ends it
+	pg_query* query = s.queries.size() ? s.queries.front().get() : nullptr;
+	pg_copy_sink* sink = query && !query->timed_out() ? query->sink() : nullptr;
+	const char* data;
+	int n;
+	while ((n = s.conn->get_copy_data(data)) > 0) {
+		_copy_bytes.fetch_add(n, std::memory_order_relaxed);
+		if (sink && !sink->write(data, n) && sink->pause(this)) {
+			s.paused = true;
+			_streams_paused.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+	}
+	return n < 0;
+}
+
+void pg_reactor::arm(pg_query& query) {
+	query.set_slot(-1);
+	if (query.has_deadline()) {
+		_timers.schedule(query.timer(), query.deadline());
+	}
+}
+
+bool pg_reactor::expire_queued(pg_query& query, std::chrono::steady_clock::time_point now) {
+	// the wheel has 1 ms ticks, a deadline passed since the last advance is checked here too
+	if (!query.timed_out() && query.deadline() <= now) {
+		query.time_out();
+		_queries_timed_out.fetch_add(1, std::memory_order_relaxed);
+	}
+	return query.timed_out();
+}
+
+void pg_reactor::expire(pg_query& query) {
+
+	if (query.timed_out()) {
+		return;
+	}
+	query.time_out();
+	_queries_timed_out.fetch_add(1, std::memory_order_relaxed);
+
+	// a queued query is dropped by dispatch, a query in flight is cancelled on the server
+	// if it is the one running, otherwise once the queries before it complete
+	if (query.slot() < 0) {
+		return;
+	}
+	slot& s = _slots[query.slot()];
+	if (s.queries.size() && s.queries.front().get() == &query) {
+		// a copy is ended by the client instead, see copy
+		if (s.conn->copying()) {
+			mark_dirty(s);
+			return;
+		}
+		cancel_expired(s);
+		// a stream that is not read would never see the cancellation
+		if (s.paused) {
+			s.paused = false;
+			mark_dirty(s);
+		}
+	}
+}
+
+void pg_reactor::cancel_expired(slot& s) {
+	//	PQcancel cancels whatever the server is running at the moment the request arrives. With commands
+	//	pipelined behind the expired query the server may have finished it and started the next one,
+	//	which would be cancelled instead: the expired query then runs to completion and its results are dropped.
+	//	Alone in flight it is cancelled, and nothing is pipelined behind it until it completes.
+	if (s.queries.size() != 1) {
+		return;
+	}
+	s.exclusive = true;
+	cancel(s);
+}
+
+void pg_reactor::cancel(slot& s) {
+	//	A command that just completed cannot be told apart, the server then cancels nothing.
+	PGcancel* c = s.conn->get_cancel();
+	if (!c) {
+		log_error("[%02d] get_cancel -> %s", s.conn->id(), s.conn->last_error().c_str());
+		return;
+	}
+	_canceller.post(c);
+	_queries_cancelled.fetch_add(1, std::memory_order_relaxed);
+}
+
+void pg_reactor::replay(slot& s) {
+
+	// The commands in flight are gone with the connection. Their queries may or may not have run
+	// on the server, so only idempotent ones are sent again, ahead of the queue in their original order.
+	std::string error = s.conn->last_error().empty() ? "connection lost" : s.conn->last_error();
+	std::size_t replayed = 0;
+	while (s.queries.size()) {
+		std::unique_ptr<pg_query> query = std::move(s.queries.back());
+		s.queries.pop_back();
+		if (!query || query->timed_out()) {
+			continue;
+		}
+		if (query->idempotent() && query->replays() < _options.max_replays) {
+			query->replay();
+			query->set_slot(-1);
+			_queries.push_front(std::move(query));
+			++replayed;
+		}
+		else {
+			query->set_exception(std::make_exception_ptr(pg_connection_error(error)));
+			_queries_aborted.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	s.probing = false;
+	s.exclusive = false;
+	s.paused = false;
+	_admission.readmit(replayed);
+	_queries_replayed.fetch_add(replayed, std::memory_order_relaxed);
+}
+
+int pg_reactor::next_timeout() {
+
+	// no fixed tick, the loop sleeps until the next timer, affinity wait or connection retry
+	auto now = std::chrono::steady_clock::now();
+	int timeout = _timers.next_timeout(now);
+	auto sooner = [&timeout](int ms) {
+		if (timeout < 0 || ms < timeout) {
+			timeout = ms;
+		}
+	};
+
+	if (_overflow_deadline != std::chrono::steady_clock::time_point::max()) {
+		sooner((int)std::max<long long>(0, std::chrono::ceil<std::chrono::milliseconds>(_overflow_deadline - now).count()));
+	}
+
+	if (_affinity.size()) {
+		// all waits have the same budget, the first one ends first
+		auto left = _affinity.front().deadline - now;
+		sooner((int)std::max<long long>(0, std::chrono::ceil<std::chrono::milliseconds>(left).count()));
+	}
+
+	// connections marked during this pass are advanced again right away
+	if (_dirty.size()) {
+		timeout = 0;
+	}
+	return timeout;
+}
+
+pg_reactor::slot* pg_reactor::pop_idle() {
+	// entries whose connection left the idle state meanwhile are dropped here
+	while (_idle.size()) {
+		slot* s = _idle.back();
+		_idle.pop_back();
+		s->idle = false;
+		if (s->conn->async_state() == pg_connection::async_state_t::idle && s->queries.empty()) {
+			return s;
+		}
+	}
+	return nullptr;
+}
+
+pg_reactor::slot* pg_reactor::pop_ready() {
+
+	if (slot* s = pop_idle()) {
+		return s;
+	}
+
+	// pipelined connections with spare depth, taken round-robin; an entry left from before
+	// its connection went idle and took a stream or a copy is dropped
+	while (_open.size()) {
+		slot* s = _open.front();
+		_open.pop_front();
+		s->open = false;
+		if (!s->exclusive && s->conn->async_state() == pg_connection::async_state_t::executing_query && s->conn->can_send()) {
+			return s;
+		}
+	}
+	return nullptr;
+}
+
+void pg_reactor::mark_dirty(slot& s) {
+	if (!s.dirty) {
+		s.dirty = true;
+		_dirty.push_back(&s);
+	}
+}
+
+// Connection sockets stay in the epoll set for the whole connection lifetime.
+// Interest is changed with EPOLL_CTL_MOD only when it differs from the registered one.
+// PQconnectStart/PQresetStart open a new socket and closing the old one removes it from the epoll set,
+// so registration is forgotten after start_connect/start_reset and the new socket is added again.
+// Stale descriptors are never deleted explicitly: the number might already belong to another socket.
+void pg_reactor::watch(slot& s, uint32_t events) {
+
+	int sock = s.conn->socket();
+	if (sock == -1 || (sock == s.fd && events == s.events)) {
+		return;
+	}
+
+	epoll_event e;
+	e.events = events;
+	e.data.ptr = &s;
+	int op = sock == s.fd ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	int r = epoll_ctl(_efd, op, sock, &e);
+	_epoll_ctl_calls.fetch_add(1, std::memory_order_relaxed);
+	if (r == -1 && (errno == EEXIST || errno == ENOENT)) {
+		op = errno == EEXIST ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+		r = epoll_ctl(_efd, op, sock, &e);
+		_epoll_ctl_calls.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (r == -1) {
+		log_error("\t[%02d] epoll_ctl -> %d", s.conn->id(), errno);
+		s.fd = -1;
+		return;
+	}
+	s.fd = sock;
+	s.events = events;
+}
+
+void pg_reactor::forget(slot& s) {
+	s.fd = -1;
+}
+
+void pg_reactor::spill(std::deque<std::unique_ptr<pg_query>>& queries) {
+
+	int wanted = 0;
+	for (pg_reactor* sibling : _siblings) {
+		wanted += sibling->_idle_connections.load(std::memory_order_relaxed);
+	}
+	if (wanted == 0) {
+		return;
+	}
+
+	// the oldest queries are moved, they are the most late ones, and taken first by the reactor that steals them
+	{
+		std::lock_guard<std::mutex> lock(_overflow_mtx);
+		std::size_t n = std::min<std::size_t>(wanted, queries.size());
+		for (std::size_t i = 0; i < n; ++i) {
+			// the timer wheel belongs to this thread, expire_overflow tracks the deadline until a reactor takes the query
+			pg_query& query = *queries.front();
+			query.timer().cancel();
+			if (query.has_deadline()) {
+				_overflow_deadline = std::min(_overflow_deadline, query.deadline());
+			}
+			_overflow.push_back(std::move(queries.front()));
+			queries.pop_front();
+		}
+		_overflow_size = _overflow.size();
+	}
+
+	for (pg_reactor* sibling : _siblings) {
+		if (sibling->_idle_connections.load(std::memory_order_relaxed) > 0) {
+			sibling->wake();
+		}
+	}
+}
+
+std::size_t pg_reactor::steal(std::deque<std::unique_ptr<pg_query>>& queries, std::size_t max) {
+
+	if (_overflow_size.load(std::memory_order_relaxed) == 0) {
+		return 0;
+	}
+
+	std::unique_lock<std::mutex> lock(_overflow_mtx, std::try_to_lock);
+	if (!lock.owns_lock()) {
+		return 0;
+	}
+
+	std::size_t n = std::min(max, _overflow.size());
+	for (std::size_t i = 0; i < n; ++i) {
+		queries.push_back(std::move(_overflow.front()));
+		_overflow.pop_front();
+	}
+	_overflow_size = _overflow.size();
+	return n;
+}
+
+void pg_reactor::expire_overflow(std::chrono::steady_clock::time_point now) {
+
+	if (now < _overflow_deadline) {
+		return;
+	}
+
+	// expired queries stay queued, timed out: the reactor that takes them drops them in dispatch
+	std::lock_guard<std::mutex> lock(_overflow_mtx);
+	_overflow_deadline = std::chrono::steady_clock::time_point::max();
+	for (auto& query : _overflow) {
+		if (query->deadline() <= now) {
+			expire(*query);
+		}
+		else if (query->has_deadline()) {
+			_overflow_deadline = std::min(_overflow_deadline, query->deadline());
+		}
+	}
+}
+
+bool pg_reactor::stealable() {
+	// checked after _parked is published, spill wakes this reactor only if it sees _parked
+	if (_idle.empty()) {
+		return false;
+	}
+	for (pg_reactor* sibling : _siblings) {
+		if (sibling->_overflow_size.load() > 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void pg_reactor::wake() {
+	// only one producer wakes a parked reactor, the rest of a burst is picked up by the same wakeup
+	if (_parked.load() && _parked.exchange(false)) {
+		cond_notify();
+	}
+}
+
+void pg_reactor::cond_notify() {
+	uint64_t one = 1;
+	write(_event_fd, &one, sizeof(one));
+	_wakeups.fetch_add(1, std::memory_order_relaxed);
+}
+
+void pg_reactor::cond_reset() {
+	uint64_t counter;
+	read(_event_fd, &counter, sizeof(counter));
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+
+#include "pg_admission.hpp"
+#include "pg_canceller.hpp"
+#include "pg_connection.hpp"
+#include "pg_copy_sink.hpp"
+#include "pg_copy_state.hpp"
+#include "pg_options.hpp"
+#include "pg_prepared.hpp"
+#include "pg_query.hpp"
+#include "pg_readiness.hpp"
+#include "pg_stats.hpp"
+#include "pg_stream.hpp"
+#include "pg_submit_queue.hpp"
+#include "pg_timer_wheel.hpp"
+
+// Event loop owning a subset of the pool connections and its own epoll instance.
+// Queries that cannot be dispatched locally are moved to an overflow queue
+// that sibling reactors with idle connections steal from.
+class pg_reactor {
+public:
+	pg_reactor(const pg_reactor&) = delete;
+	pg_reactor& operator=(const pg_reactor&) = delete;
+
+	pg_reactor(int id, const std::map<std::string, std::string>& connection_params, pg_admission& admission, pg_readiness& readiness);
+	~pg_reactor();
+
+	void set_siblings(std::vector<pg_reactor*> siblings);
+
+	// connections get ids from first_connection_id, n_connections are opened and up to max_connections later on
+	void start(int first_connection_id, int n_connections, int max_connections, const pg_pool_options& options, int cpu = -1);
+	void request_stop();
+	void join();
+
+	// Embedded mode: the reactor runs on the caller's event loop instead of its own thread.
+	// start_embedded opens the connections, then the caller calls run_once whenever fd() is readable
+	// or timeout() has passed, and stop_embedded, all from the same thread.
+	bool start_embedded(int first_connection_id, int n_connections, int max_connections, const pg_pool_options& options);
+	int fd() const { return _efd; }
+	int timeout();
+	void run_once(int timeout_ms);
+	void stop_embedded();
+
+	void submit(pg_query* query);
+
+	// moves the queries still queued on a stopped reactor to queue, in submission order
+	void drain(pg_submit_queue& queue);
+
+	// reads connections again that were stopped by a full stream or copy sink and sends the data written
+	// to copies, called by pg_stream, pg_copy_sink and pg_copy_state from any thread
+	void resume();
+
+	// statements prepared on every connection before it takes queries, see async_pg::prepare
+	void set_registry(std::shared_ptr<const std::vector<pg_prepared>> registry);
+	void add_stats(pg_stats& stats) const;
+
+	const int& id() const { return _id; }
+
+private:
+	// Per-connection scheduling state, kept in one dense array owned by the loop.
+	// A slot is in _idle while its connection waits for a query, in _open while a pipelined
+	// connection has spare depth and in _dirty while its state has to be re-evaluated,
+	// so dispatch and completion are O(1).
+	struct slot {
+		std::unique_ptr<pg_connection> conn;
+		std::deque<std::unique_ptr<pg_query>> queries;	// in flight, in send order; nullptr for a statement preparation
+		std::size_t prepared = 0;	// registered statements already sent on this connection
+		int fd = -1;			// socket registered in epoll
+		uint32_t events = 0;	// registered interest
+		bool idle = false;
+		bool open = false;
+		bool dirty = false;
+		bool active = false;	// connection opened, otherwise a spare slot for the pool to grow
+		bool up = false;		// connected, until the connection fails
+		bool reported = false;	// counted for the readiness of the pool
+		bool probing = false;	// keepalive probe in flight
+		bool exclusive = false;	// a stream, a copy or a cancelled query is in flight, nothing is pipelined behind it
+		bool paused = false;	// not read until the consumer of the stream or the copy sink takes rows
+		int backoff_ms = 0;		// delay before the next attempt after this one fails
+		std::chrono::steady_clock::time_point retry_at;
+		std::chrono::steady_clock::time_point idle_since;	// since the last query, probes excluded
+		std::chrono::steady_clock::time_point probed_at;
+		std::chrono::steady_clock::time_point recycle_at;
+	};
+
+	void process(int first_connection_id, int n_connections, int max_connections, int cpu);
+	bool setup(int first_connection_id, int n_connections, int max_connections);
+	void prepare();
+	void poll(int max_timeout);
+	void teardown();
+	void advance(slot& s);
+	void dispatch();
+	bool send(slot& s, std::unique_ptr<pg_query>& query);
+	void warm_up(slot& s);
+	const std::vector<Oid>& param_types(const std::string& name) const;
+	void hold(const std::string& name, slot& s);
+	slot* find_holder(const std::string& name, bool& held);
+	void handle_event(slot& s, uint32_t events);
+	void complete(slot& s, std::list<pg_result>&& results);
+	void stream(slot& s, std::list<pg_result>&& rows);
+	void unpause();
+	void copy_in(slot& s);
+	bool copy_out(slot& s);
+	void arm(pg_query& query);
+	bool expire_queued(pg_query& query, std::chrono::steady_clock::time_point now);
+	void expire(pg_query& query);
+	void cancel_expired(slot& s);
+	void cancel(slot& s);
+	void replay(slot& s);
+	int next_timeout();
+	bool shed(pg_query& query, std::chrono::steady_clock::time_point now);
+	void set_shedding(bool shedding);
+	void resize();
+	void open(slot& s);
+	void retire(slot& s);
+	bool backoff(slot& s);
+	void retry_later(std::chrono::steady_clock::time_point when);
+	void reconnect();
+	void maintain();
+	void probe(slot& s);
+	void recycle(slot& s);
+	slot* pop_idle();
+	slot* pop_ready();
+	void mark_dirty(slot& s);
+	void watch(slot& s, uint32_t events);
+	void forget(slot& s);
+	void spill(std::deque<std::unique_ptr<pg_query>>& queries);
+	std::size_t steal(std::deque<std::unique_ptr<pg_query>>& queries, std::size_t max);
+	void expire_overflow(std::chrono::steady_clock::time_point now);
+	bool stealable();
+	void wake();
+	void cond_notify();
+	void cond_reset();
+
+	int _id;
+	std::map<std::string, std::string> _connection_params;
+	std::map<std::string, std::string> _connect_params;	// with the keepalive settings of the options
+	pg_pool_options _options;
+	pg_admission& _admission;
+	pg_readiness& _readiness;
+	std::vector<pg_reactor*> _siblings;
+
+	std::atomic<bool> _running;
+	std::atomic<bool> _parked;	// reactor is (about to be) blocked in epoll_wait
+	std::thread _thr;
+	pg_submit_queue _submissions;
+	int _event_fd;
+	int _efd;
+
+	// owned by the reactor thread
+	std::vector<epoll_event> _events;
+	std::vector<slot*> _advancing;	// _dirty taken by the current pass
+	std::vector<pg_timer*> _expired;
+	std::vector<slot> _slots;
+	std::vector<slot*> _idle;
+	std::deque<slot*> _open;
+	std::vector<slot*> _dirty;
+	std::deque<std::unique_ptr<pg_query>> _queries;
+	std::shared_ptr<const std::vector<pg_prepared>> _registry;
+	pg_timer_wheel _timers;		// query deadlines
+	pg_canceller _canceller;
+
+	// pool sizing, see resize
+	pg_timer _resize_timer;
+	int _min_connections;
+	int _active;
+	int _busy_ticks;
+
+	// earliest retry of a failed connection, see backoff
+	pg_timer _reconnect_timer;
+	std::chrono::steady_clock::time_point _reconnect_at;
+	std::minstd_rand _rng;
+
+	// keepalive probes and lifetime, see maintain
+	pg_timer _maintenance_timer;
+
+	// CoDel state, see shed
+	bool _shedding;
+	uint32_t _shed_count;
+	std::chrono::steady_clock::time_point _shed_first_above;
+	std::chrono::steady_clock::time_point _shed_next;
+
+	// prepared queries waiting for a connection that already holds their statement
+	struct affinity_wait {
+		std::unique_ptr<pg_query> query;
+		std::chrono::steady_clock::time_point deadline;
+	};
+	std::deque<affinity_wait> _affinity;
+	std::unordered_map<std::string, std::vector<slot*>> _holders;	// slots that prepared a statement
+
+	// registry published by set_registry, taken by the loop when _registry_changed is set
+	std::mutex _registry_mtx;
+	std::shared_ptr<const std::vector<pg_prepared>> _next_registry;
+	std::atomic<bool> _registry_changed;
+
+	// set by resume, paused and copying slots are checked when the loop takes it
+	std::atomic<bool> _resumed;
+	std::string _copy_chunk;	// swapped with the buffer of a pg_copy_state, see copy
+
+	// backlog shared with siblings, only touched when this reactor has no idle connection
+	std::mutex _overflow_mtx;
+	std::deque<std::unique_ptr<pg_query>> _overflow;
+	std::atomic<std::size_t> _overflow_size;
+	std::atomic<int> _idle_connections;
+	// owned by the loop: earliest deadline of the queries spilled to _overflow, see expire_overflow
+	std::chrono::steady_clock::time_point _overflow_deadline = std::chrono::steady_clock::time_point::max();
+	std::deque<std::unique_ptr<pg_query>> _taken;	// queries stolen by prepare, kept to steal without allocating
+
+	std::atomic<uint64_t> _queries_completed;
+	std::atomic<uint64_t> _queries_stolen;
+	std::atomic<uint64_t> _queries_timed_out;
+	std::atomic<uint64_t> _queries_cancelled;
+	std::atomic<uint64_t> _queries_shed;
+	std::atomic<uint64_t> _queries_replayed;
+	std::atomic<uint64_t> _queries_aborted;
+	std::atomic<uint64_t> _rows_streamed;
+	std::atomic<uint64_t> _streams_paused;
+	std::atomic<uint64_t> _copy_bytes;
+	std::atomic<int> _connections;
+	std::atomic<uint64_t> _connections_grown;
+	std::atomic<uint64_t> _connections_retired;
+	std::atomic<uint64_t> _connections_recycled;
+	std::atomic<uint64_t> _keepalive_probes;
+	std::atomic<uint64_t> _epoll_wait_calls;
+	std::atomic<uint64_t> _epoll_ctl_calls;
+	std::atomic<uint64_t> _wakeups;
+	std::atomic<uint64_t> _prepared_hits;
+	std::atomic<uint64_t> _prepared_misses;
+};
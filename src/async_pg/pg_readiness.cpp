@@ -0,0 +1,40 @@
+#include "pg_readiness.hpp"
+#include <stdexcept>
+
+pg_readiness::pg_readiness() :
+	_wanted(0),
+	_done(true)
+{}
+
+std::shared_future<void> pg_readiness::reset(int wanted) {
+	std::lock_guard<std::mutex> lock(_mtx);
+	_promise = std::promise<void>();
+	_future = _promise.get_future().share();
+	_wanted = wanted;
+	_done = wanted <= 0;
+	if (_done) {
+		_promise.set_value();
+	}
+	return _future;
+}
+
+std::shared_future<void> pg_readiness::future() {
+	std::lock_guard<std::mutex> lock(_mtx);
+	return _future;
+}
+
+void pg_readiness::connected() {
+	std::lock_guard<std::mutex> lock(_mtx);
+	if (!_done && --_wanted == 0) {
+		_done = true;
+		_promise.set_value();
+	}
+}
+
+void pg_readiness::abandon(const std::string& error) {
+	std::lock_guard<std::mutex> lock(_mtx);
+	if (!_done) {
+		_done = true;
+		_promise.set_exception(std::make_exception_ptr(std::runtime_error(error)));
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <future>
+#include <mutex>
+#include <string>
+
+// Readiness of the pool returned by async_pg::start: ready once the wanted number
+// of connections have connected, failed if the pool stops before that.
+class pg_readiness {
+public:
+	pg_readiness(const pg_readiness&) = delete;
+	pg_readiness& operator=(const pg_readiness&) = delete;
+
+	pg_readiness();
+
+	std::shared_future<void> reset(int wanted);
+	std::shared_future<void> future();
+	// a connection connected for the first time since reset
+	void connected();
+	void abandon(const std::string& error);
+
+private:
+	std::mutex _mtx;
+	std::promise<void> _promise;
+	std::shared_future<void> _future;
+	int _wanted;
+	bool _done;
+};
@@ -1,5 +1,6 @@
 #include "pg_result.hpp"
 #include <sstream>
+#include <stdexcept>
 #include <iomanip>
 
 pg_result::pg_result(PGresult* res) : _res(res) {}
@@ -41,55 +42,73 @@ void pg_result::check() {
 	}
 }
 
-int pg_result::rows_count() {
+ExecStatusType pg_result::status() const {
+	return PQresultStatus(_res);
+}
+
+int pg_result::rows_count() const {
 	if (_res) {
 		return PQntuples(_res);
 	}
 	return 0;
 }
 
-int pg_result::cols_count() {
+int pg_result::cols_count() const {
 	if (_res) {
 		return PQnfields(_res);
 	}
 	return 0;
 }
 
-const char* pg_result::col_name(int col_number) {
+const char* pg_result::col_name(int col_number) const {
 	if (_res) {
 		return PQfname(_res, col_number);
 	}
 	return nullptr;
 }
 
-Oid pg_result::col_oid_number(int col_number) {
+Oid pg_result::col_oid_number(int col_number) const {
 	if (_res) {
 		return PQftype(_res, col_number);
 	}
 	return 0;
 }
 
-int pg_result::col_number(const char* col_name) {
+int pg_result::col_number(const char* col_name) const {
 	if (_res) {
 		return PQfnumber(_res, col_name);
 	}
 	return -1;
 }
 
-const char* pg_result::get_value(int row_number, int col_number) {
+const char* pg_result::get_value(int row_number, int col_number) const {
 	if (_res) {
 		return PQgetvalue(_res, row_number, col_number);
 	}
 	return nullptr;
 }
 
-bool pg_result::is_null(int row_number, int col_number) {
+bool pg_result::is_null(int row_number, int col_number) const {
 	if (_res) {
 		return PQgetisnull(_res, row_number, col_number);
 	}
 	return true;
 }
 
+int pg_result::get_length(int row_number, int col_number) const {
+	if (_res) {
+		return PQgetlength(_res, row_number, col_number);
+	}
+	return 0;
+}
+
+bool pg_result::is_binary(int col_number) const {
+	if (_res) {
+		return PQfformat(_res, col_number) == 1;
+	}
+	return false;
+}
+
 int pg_result::rows_affected() {
 	if (_res) {
 		 return std::atol(PQcmdTuples(_res));
@@ -97,6 +116,22 @@ int pg_result::rows_affected() {
 	return 0;
 }
 
+const char* pg_result::typed_value(int row_number, int col_number, const char* type, bool (*accepts)(Oid, bool)) const {
+
+	if (!_res || row_number < 0 || row_number >= PQntuples(_res) || col_number < 0 || col_number >= PQnfields(_res)) {
+		throw std::runtime_error("no value at row " + std::to_string(row_number) + ", column " + std::to_string(col_number));
+	}
+
+	Oid oid = PQftype(_res, col_number);
+	if (!accepts(oid, PQfformat(_res, col_number) == 1)) {
+		throw std::runtime_error(std::string("column ") + PQfname(_res, col_number) + " of type oid " + std::to_string(oid) + " cannot be read as " + type);
+	}
+	if (PQgetisnull(_res, row_number, col_number)) {
+		throw std::runtime_error(std::string("column ") + PQfname(_res, col_number) + " is null at row " + std::to_string(row_number));
+	}
+	return PQgetvalue(_res, row_number, col_number);
+}
+
 std::string pg_result::dump() {
 
 	ExecStatusType status = PQresultStatus(_res);
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include "libpq-fe.h"
+#include "pg_decoder.hpp"
+#include "pg_types.hpp"
 
 
 class pg_result {
@@ -16,18 +21,39 @@ public:
 	pg_result& operator=(const pg_result&) = delete;
 
 	void check();
-	int rows_count();
-	int cols_count();
+	ExecStatusType status() const;
+	int rows_count() const;
+	int cols_count() const;
 	
-	const char* col_name(int col_number);
-	Oid col_oid_number(int col_number);
-	int col_number(const char* col_name);
-	const char* get_value(int row_number, int col_number);
-	bool is_null(int row_number, int col_number);
+	const char* col_name(int col_number) const;
+	Oid col_oid_number(int col_number) const;
+	int col_number(const char* col_name) const;
+	const char* get_value(int row_number, int col_number) const;
+	bool is_null(int row_number, int col_number) const;
+	int get_length(int row_number, int col_number) const;
+	// the column is in binary format, see pg_format
+	bool is_binary(int col_number) const;
 	int rows_affected();
+
+	// Value of a column decoded in place, from binary results (see pg_format) or parsed from text:
+	// bool, int16_t, int32_t, int64_t, float, double, std::string_view, std::string, pg_bytes, pg_uuid and
+	// std::chrono::system_clock::time_point for timestamp and timestamptz, see pg_decoder.
+	// The column type has to match T, integers and floats may widen. Throws std::runtime_error otherwise
+	// and on a null value.
+	// std::string_view and pg_bytes point into the result and are valid as long as it.
+	template <typename T>
+	T get(int row_number, int col_number) const {
+		const char* value = typed_value(row_number, col_number, pg_decoder<T>::name, pg_decoder<T>::accepts);
+		return pg_decoder<T>::decode(value, PQgetlength(_res, row_number, col_number), PQfformat(_res, col_number) == 1);
+	}
 	
 	std::string dump();
 
 private:
+	friend class pg_columns;
+
+	// the value after checking it is not null and its column type is accepted
+	const char* typed_value(int row_number, int col_number, const char* type, bool (*accepts)(Oid, bool)) const;
+
 	PGresult* _res;
 };
\ No newline at end of file
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "pg_decoder.hpp"
+#include "pg_result.hpp"
+
+// Mapping of result rows to a struct, by column name:
+//
+//	struct user {
+//		int64_t id;
+//		std::string name;
+//		std::optional<std::chrono::system_clock::time_point> last_login;
+//	};
+//	PG_ROW(user, PG_FIELD(user, id), PG_FIELD(user, name), PG_FIELD(user, last_login));
+//
+//	std::vector<user> users = pg_rows<user>(results.front());
+//
+// The columns are looked up and their types checked against the fields once per result, then every row
+// is decoded into the vector with the decoder of each field, see pg_decoder; nothing is allocated per field
+// besides std::string fields. A std::optional field is empty for a null value, other fields throw
+// std::runtime_error on null, as do missing columns and mismatched types.
+
+// a column and the member it is decoded into
+template <typename T, typename M>
+struct pg_field {
+	const char* name;
+	M T::* member;
+};
+
+template <typename T, typename M>
+constexpr pg_field<T, M> pg_member(const char* name, M T::* member) {
+	return pg_field<T, M>{ name, member };
+}
+
+// the column named after the member
+#define PG_FIELD(type, member) pg_member(#member, &type::member)
+
+// Fields of T, specialized by PG_ROW with a tuple of pg_field
+template <typename T>
+struct pg_row;
+
+#define PG_ROW(type, ...) \
+	template <> \
+	struct pg_row<type> { \
+		static constexpr auto fields = std::make_tuple(__VA_ARGS__); \
+	}
+
+template <typename M>
+struct pg_field_type {
+	using type = M;
+	static constexpr bool nullable = false;
+};
+
+template <typename M>
+struct pg_field_type<std::optional<M>> {
+	using type = M;
+	static constexpr bool nullable = true;
+};
+
+// column of a field, resolved once per result
+struct pg_field_column {
+	int col;
+	bool binary;
+};
+
+template <typename T, typename M>
+pg_field_column pg_resolve(const pg_result& result, const pg_field<T, M>& field) {
+	using decoder = pg_decoder<typename pg_field_type<M>::type>;
+	int col = result.col_number(field.name);
+	if (col < 0) {
+		throw std::runtime_error(std::string("no column ") + field.name + " in the result");
+	}
+	bool binary = result.is_binary(col);
+	Oid oid = result.col_oid_number(col);
+	if (!decoder::accepts(oid, binary)) {
+		throw std::runtime_error(std::string("column ") + field.name + " of type oid " + std::to_string(oid) + " cannot be read as " + decoder::name);
+	}
+	return pg_field_column{ col, binary };
+}
+
+template <typename T, typename M>
+void pg_decode_field(const pg_result& result, int row, const pg_field_column& column, const pg_field<T, M>& field, T& out) {
+	using field_type = pg_field_type<M>;
+	using decoder = pg_decoder<typename field_type::type>;
+	if (result.is_null(row, column.col)) {
+		if constexpr (field_type::nullable) {
+			(out.*field.member).reset();
+			return;
+		}
+		else {
+			throw std::runtime_error(std::string("column ") + field.name + " is null at row " + std::to_string(row));
+		}
+	}
+	out.*field.member = decoder::decode(result.get_value(row, column.col), result.get_length(row, column.col), column.binary);
+}
+
+template <typename T, typename Fields, std::size_t... I>
+void pg_rows(const pg_result& result, std::vector<T>& rows, const Fields& fields, std::index_sequence<I...>) {
+	std::array<pg_field_column, sizeof...(I)> columns = { pg_resolve(result, std::get<I>(fields))... };
+	int n = result.rows_count();
+	rows.reserve(rows.size() + n);
+	for (int r = 0; r < n; ++r) {
+		T& row = rows.emplace_back();
+		(pg_decode_field(result, r, columns[I], std::get<I>(fields), row), ...);
+	}
+}
+
+// appends the rows of result to rows, with a tuple of pg_field
+template <typename T, typename... M>
+void pg_rows(const pg_result& result, std::vector<T>& rows, const std::tuple<pg_field<T, M>...>& fields) {
+	pg_rows(result, rows, fields, std::index_sequence_for<M...>{});
+}
+
+// appends the rows of result to rows, with the fields of PG_ROW
+template <typename T>
+void pg_rows(const pg_result& result, std::vector<T>& rows) {
+	pg_rows(result, rows, pg_row<T>::fields);
+}
+
+template <typename T>
+std::vector<T> pg_rows(const pg_result& result) {
+	std::vector<T> rows;
+	pg_rows(result, rows);
+	return rows;
+}
@@ -0,0 +1,13 @@
+#include "pg_statement.hpp"
+
+pg_statement::pg_statement(const std::string& sql, const std::list<pg_param>& params) :
+	_sql(sql), _params(params) {}
+
+pg_statement::pg_statement(std::string&& sql, std::list<pg_param>&& params) :
+	_sql(std::move(sql)), _params(std::move(params)) {}
+
+pg_statement::pg_statement(const std::string& name, const std::string& sql, const std::list<pg_param>& params) :
+	_name(name), _sql(sql), _params(params) {}
+
+pg_statement::pg_statement(std::string&& name, std::string&& sql, std::list<pg_param>&& params) :
+	_name(std::move(name)), _sql(std::move(sql)), _params(std::move(params)) {}
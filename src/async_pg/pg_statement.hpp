@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <list>
+#include "pg_param.hpp"
+
+// One statement of a batch, see async_pg::execute_batch.
+// A statement with a name is executed as a prepared statement.
+class pg_statement {
+public:
+	pg_statement(const std::string& sql, const std::list<pg_param>& params = {});
+	pg_statement(std::string&& sql, std::list<pg_param>&& params = {});
+	pg_statement(const std::string& name, const std::string& sql, const std::list<pg_param>& params);
+	pg_statement(std::string&& name, std::string&& sql, std::list<pg_param>&& params);
+
+	const std::string& name() const { return _name; }
+	const std::string& sql() const { return _sql; }
+	const std::list<pg_param>& params() const { return _params; }
+
+private:
+	std::string _name;
+	std::string _sql;
+	std::list<pg_param> _params;
+};
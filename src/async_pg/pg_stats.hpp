@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+// Snapshot of the reactor counters, see async_pg::stats()
+struct pg_stats {
+	uint64_t queries_completed = 0;
+	uint64_t queries_stolen = 0;		// taken from the overflow queue of another reactor
+	uint64_t queries_timed_out = 0;		// failed by their deadline, queued or in flight
+	uint64_t queries_cancelled = 0;		// cancel requests sent for queries in flight
+	uint64_t queries_rejected = 0;		// refused at submission: queue full or overloaded
+	uint64_t queries_shed = 0;			// dropped from the queue by load shedding
+	uint64_t queries_replayed = 0;		// idempotent queries sent again after their connection was lost
+	uint64_t queries_aborted = 0;		// failed with pg_connection_error
+	uint64_t rows_streamed = 0;			// rows delivered to pg_stream consumers
+	uint64_t streams_paused = 0;		// times a full stream or copy sink stopped reading its connection
+	uint64_t copy_bytes = 0;			// COPY data sent and received
+	uint64_t connections = 0;			// open or opening now
+	uint64_t connections_grown = 0;		// opened by the pool above n_connections
+	uint64_t connections_retired = 0;	// closed after idle_timeout_ms
+	uint64_t connections_recycled = 0;	// replaced after max_lifetime_ms
+	uint64_t keepalive_probes = 0;		// empty queries sent on idle connections
+	uint64_t epoll_wait_calls = 0;
+	uint64_t epoll_ctl_calls = 0;
+	uint64_t wakeups = 0;		// notifications written by producers to wake up the reactor
+	uint64_t prepared_hits = 0;		// prepared queries sent to a connection that had the statement
+	uint64_t prepared_misses = 0;	// prepared queries that had to prepare the statement first
+};
@@ -0,0 +1,104 @@
+#include "pg_stream.hpp"
+#include "pg_reactor.hpp"
+
+pg_stream::pg_stream(std::size_t capacity) : _capacity(capacity ? capacity : 1) {}
+
+pg_stream::~pg_stream() {}
+
+std::size_t pg_stream::next_batch(std::list<pg_result>& rows, std::size_t max) {
+
+	std::unique_lock<std::mutex> lock(_mtx);
+	_cv.wait(lock, [this] { return _rows.size() || _done; });
+
+	std::size_t n = std::min(max, _rows.size());
+	for (std::size_t i = 0; i < n; ++i) {
+		rows.push_back(std::move(_rows.front()));
+		_rows.pop_front();
+	}
+
+	// the reactor is resumed under the lock, it cannot complete the query and go away meanwhile
+	if (_paused && _rows.size() <= _capacity / 2) {
+		_paused->resume();
+		_paused = nullptr;
+	}
+
+	if (n == 0 && _error) {
+		std::rethrow_exception(_error);
+	}
+	return n;
+}
+
+std::optional<pg_result> pg_stream::next() {
+	std::list<pg_result> rows;
+	if (next_batch(rows, 1) == 0) {
+		return std::nullopt;
+	}
+	return std::move(rows.front());
+}
+
+void pg_stream::close() {
+	std::lock_guard<std::mutex> lock(_mtx);
+	_closed = true;
+	_rows.clear();
+	if (_paused) {
+		_paused->resume();
+		_paused = nullptr;
+	}
+}
+
+bool pg_stream::push(std::list<pg_result>&& rows, pg_reactor* reactor) {
+
+	std::lock_guard<std::mutex> lock(_mtx);
+	if (_closed) {
+		return true;
+	}
+	bool wake = _rows.empty();
+	for (auto& row : rows) {
+		_rows.push_back(std::move(row));
+	}
+	if (wake) {
+		_cv.notify_one();
+	}
+	if (_rows.size() >= _capacity) {
+		_paused = reactor;
+		return false;
+	}
+	return true;
+}
+
+void pg_stream::finish(std::exception_ptr error, std::list<pg_result>&& results) {
+
+	std::lock_guard<std::mutex> lock(_mtx);
+	_paused = nullptr;
+	_done = true;
+	_error = error;
+	for (auto it = results.begin(); it != results.end();) {
+		try {
+			it->check();
+		}
+		catch (...) {
+			if (!_error) {
+				_error = std::current_exception();
+			}
+		}
+		// rows of a statement that was not run in single-row mode
+		if (it->status() == PGRES_TUPLES_OK && it->rows_count() > 0 && !_closed) {
+			_rows.push_back(std::move(*it));
+			it = results.erase(it);
+			continue;
+		}
+		++it;
+	}
+	_results = std::move(results);
+	_cv.notify_all();
+}
+
+bool pg_stream::paused() {
+	std::lock_guard<std::mutex> lock(_mtx);
+	return _paused != nullptr;
+}
+
+bool pg_stream::closed() {
+	std::lock_guard<std::mutex> lock(_mtx);
+	return _closed;
+}
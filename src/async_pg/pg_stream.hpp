@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <list>
+#include <mutex>
+#include <optional>
+#include "pg_result.hpp"
+
+class pg_reactor;
+
+// Rows of a query delivered while it runs, see async_pg::stream.
+// The query runs in libpq single-row mode: the reactor appends every row as it arrives,
+// as a pg_result holding that row, and the consumer takes them with next or next_batch.
+// Once capacity rows wait the reactor stops reading the connection, the server then blocks
+// on its socket, and reading resumes when the consumer has taken half of them. Rows already read
+// from the socket are still delivered, so memory stays bounded by capacity plus one read
+// whatever the size of the result.
+class pg_stream {
+public:
+	pg_stream(const pg_stream&) = delete;
+	pg_stream& operator=(const pg_stream&) = delete;
+
+	explicit pg_stream(std::size_t capacity);
+	~pg_stream();
+
+	// Waits for rows and moves up to max of them to rows. Returns 0 once the query completed,
+	// after all its rows were taken, and throws its error if it failed. A statement that could not run
+	// in single-row mode delivers all its rows at the end, in one pg_result.
+	std::size_t next_batch(std::list<pg_result>& rows, std::size_t max);
+
+	// next row, nothing at the end
+	std::optional<pg_result> next();
+
+	// The consumer stops early: rows waiting and still to come are dropped and the query is cancelled.
+	void close();
+
+	// the final result, with the command status, once next returned nothing
+	std::list<pg_result>& results() { return _results; }
+
+	std::size_t capacity() const { return _capacity; }
+
+private:
+	friend class pg_reactor;
+	friend class async_pg;
+
+	// Called by the reactor. Returns false when capacity rows wait: the reactor stops reading
+	// and is resumed by the consumer.
+	bool push(std::list<pg_result>&& rows, pg_reactor* reactor);
+	void finish(std::exception_ptr error, std::list<pg_result>&& results);
+	bool paused();
+	bool closed();
+
+	std::mutex _mtx;
+	std::condition_variable _cv;
+	std::deque<pg_result> _rows;
+	std::list<pg_result> _results;
+	std::exception_ptr _error;
+	std::size_t _capacity;
+	pg_reactor* _paused = nullptr;	// reactor to resume, set while it does not read
+	bool _done = false;
+	bool _closed = false;
+	bool _cancelled = false;	// owned by the reactor, cancel sent after close
+};
@@ -0,0 +1,37 @@
+#include "pg_submit_queue.hpp"
+
+pg_submit_queue::pg_submit_queue() : _head(nullptr) {}
+
+pg_submit_queue::~pg_submit_queue() {
+	pg_query* query = pop_all();
+	while (query) {
+		pg_query* next = query->_next;
+		delete query;
+		query = next;
+	}
+}
+
+bool pg_submit_queue::push(pg_query* query) {
+	query->_next = _head.load(std::memory_order_relaxed);
+	while (!_head.compare_exchange_weak(query->_next, query)) {}
+	return query->_next == nullptr;
+}
+
+pg_query* pg_submit_queue::pop_all() {
+
+	pg_query* head = _head.exchange(nullptr);
+
+	// producers push to the front, reverse to get submission order
+	pg_query* ordered = nullptr;
+	while (head) {
+		pg_query* next = head->_next;
+		head->_next = ordered;
+		ordered = head;
+		head = next;
+	}
+	return ordered;
+}
+
+bool pg_submit_queue::empty() const {
+	return _head.load() == nullptr;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <atomic>
+#include "pg_query.hpp"
+
+// Intrusive lock-free multi-producer/single-consumer queue of submitted queries.
+// Producers push heap allocated queries, linked through pg_query::_next.
+// The consumer detaches everything at once with pop_all() and takes ownership.
+class pg_submit_queue {
+public:
+	pg_submit_queue();
+	~pg_submit_queue();
+
+	pg_submit_queue(const pg_submit_queue&) = delete;
+	pg_submit_queue& operator=(const pg_submit_queue&) = delete;
+
+	// returns true if the queue was empty before the push
+	bool push(pg_query* query);
+
+	// detaches all queued queries, the returned chain is in submission order
+	pg_query* pop_all();
+
+	bool empty() const;
+
+private:
+	std::atomic<pg_query*> _head;
+};
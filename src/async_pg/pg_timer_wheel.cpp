@@ -0,0 +1,185 @@
+#include "pg_timer_wheel.hpp"
+#include <algorithm>
+
+void pg_timer::cancel() {
+	if (_prev) {
+		_prev->_next = _next;
+		_next->_prev = _prev;
+		_prev = nullptr;
+		_next = nullptr;
+	}
+}
+
+pg_timer_wheel::pg_timer_wheel() :
+	_epoch(clock::now()),
+	_now(0)
+{
+	for (int l = 0; l < levels; ++l) {
+		for (int i = 0; i < buckets; ++i) {
+			_heads[l][i]._prev = &_heads[l][i];
+			_heads[l][i]._next = &_heads[l][i];
+		}
+		_occupied[l] = 0;
+	}
+}
+
+pg_timer_wheel::~pg_timer_wheel() {
+	// timers still armed are detached, their owners outlive the wheel
+	for (int l = 0; l < levels; ++l) {
+		for (int i = 0; i < buckets; ++i) {
+			pg_timer* head = &_heads[l][i];
+			while (head->_next != head) {
+				head->_next->cancel();
+			}
+		}
+	}
+}
+
+uint64_t pg_timer_wheel::to_tick(clock::time_point t, bool round_up) const {
+	if (t <= _epoch) {
+		return 0;
+	}
+	auto d = t - _epoch;
+	auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(d);
+	if (round_up && ms < d) {
+		++ms;
+	}
+	return (uint64_t)ms.count();
+}
+
+bool pg_timer_wheel::empty(int level, int index) const {
+	const pg_timer* head = &_heads[level][index];
+	if (head->_next == head) {
+		_occupied[level] &= ~(1ull << index);
+		return true;
+	}
+	return false;
+}
+
+void pg_timer_wheel::schedule(pg_timer& timer, clock::time_point deadline) {
+	timer.cancel();
+	timer._expires = std::max(to_tick(deadline, true), _now + 1);
+	place(timer);
+}
+
+void pg_timer_wheel::place(pg_timer& timer) {
+
+	// the level is given by the highest digit that differs from the current tick
+	int level = 0;
+	while (level < levels - 1 && (timer._expires >> (bits * (level + 1))) != (_now >> (bits * (level + 1)))) {
+		++level;
+	}
+
+	// in the top level the expiry might be in the next turn of the wheel, its bucket is then behind the current one
+	int index;
+	if (timer._expires - _now >= 1ull << (bits * levels)) {
+		// out of range, parked in the last bucket the top level reaches before it wraps around
+		index = (int)((_now >> (bits * level)) + buckets - 1) & (buckets - 1);
+	}
+	else {
+		index = (int)(timer._expires >> (bits * level)) & (buckets - 1);
+	}
+
+	pg_timer* head = &_heads[level][index];
+	timer._prev = head->_prev;
+	timer._next = head;
+	head->_prev->_next = &timer;
+	head->_prev = &timer;
+	_occupied[level] |= 1ull << index;
+}
+
+void pg_timer_wheel::cascade(int level, int index) {
+	pg_timer* head = &_heads[level][index];
+	pg_timer list;
+	if (head->_next == head) {
+		return;
+	}
+
+	// detach the bucket first, timers might be placed back into it
+	list._next = head->_next;
+	list._prev = head->_prev;
+	list._next->_prev = &list;
+	list._prev->_next = &list;
+	head->_next = head;
+	head->_prev = head;
+	_occupied[level] &= ~(1ull << index);
+
+	while (list._next != &list) {
+		pg_timer* t = list._next;
+		t->cancel();
+		place(*t);
+	}
+	list._prev = nullptr;
+	list._next = nullptr;
+}
+
+uint64_t pg_timer_wheel::next_tick() const {
+
+	// earliest tick at which a non-empty bucket is reached, 0 if there is none
+	uint64_t next = 0;
+	for (int l = 0; l < levels; ++l) {
+		int shift = bits * l;
+		int current = (int)(_now >> shift) & (buckets - 1);
+		uint64_t base = (_now >> (shift + bits)) << (shift + bits);
+
+		for (uint64_t mask = _occupied[l]; mask; mask &= mask - 1) {
+			int index = __builtin_ctzll(mask);
+			if (empty(l, index)) {
+				continue;
+			}
+			// buckets behind the current one are reached after the level wraps around
+			uint64_t tick = base + ((uint64_t)index << shift);
+			if (index <= current) {
+				tick += (uint64_t)buckets << shift;
+			}
+			if (!next || tick < next) {
+				next = tick;
+			}
+		}
+	}
+	return next;
+}
+
+void pg_timer_wheel::advance(clock::time_point now, std::vector<pg_timer*>& expired) {
+
+	uint64_t target = to_tick(now, false);
+	while (true) {
+		uint64_t tick = next_tick();
+		if (!tick || tick > target) {
+			break;
+		}
+		_now = tick;
+
+		// higher levels first, they might move timers down into the bucket that expires now
+		for (int l = levels - 1; l > 0; --l) {
+			uint64_t span = 1ull << (bits * l);
+			if ((_now & (span - 1)) == 0) {
+				cascade(l, (int)(_now >> (bits * l)) & (buckets - 1));
+			}
+		}
+
+		pg_timer* head = &_heads[0][_now & (buckets - 1)];
+		while (head->_next != head) {
+			pg_timer* t = head->_next;
+			t->cancel();
+			expired.push_back(t);
+		}
+	}
+
+	if (target > _now) {
+		_now = target;
+	}
+}
+
+int pg_timer_wheel::next_timeout(clock::time_point now) const {
+	uint64_t tick = next_tick();
+	if (!tick) {
+		return -1;
+	}
+	uint64_t current = to_tick(now, false);
+	if (tick <= current) {
+		return 0;
+	}
+	uint64_t ms = tick - current;
+	return ms > (uint64_t)INT32_MAX ? INT32_MAX : (int)ms;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Intrusive timer of pg_timer_wheel, it unlinks itself when cancelled or destroyed.
+class pg_timer {
+public:
+	pg_timer(void* owner = nullptr) : _owner(owner) {}
+	~pg_timer() { cancel(); }
+
+	pg_timer(const pg_timer&) = delete;
+	pg_timer& operator=(const pg_timer&) = delete;
+
+	void cancel();
+	bool armed() const { return _prev != nullptr; }
+	void* owner() const { return _owner; }
+
+private:
+	friend class pg_timer_wheel;
+
+	void* _owner;
+	pg_timer* _prev = nullptr;
+	pg_timer* _next = nullptr;
+	uint64_t _expires = 0;	// in ticks of the wheel
+};
+
+// Hierarchical timing wheel with 1 ms ticks, owned by one thread.
+// Level l has 64 buckets of 64^l ticks each. A timer is placed in the lowest level where its
+// expiry shares the higher-order digits with the current tick, and moves down a level each time
+// the wheel reaches its bucket, so schedule, cancel and expiry are O(1).
+// Timers further than 64^4 ticks (~4.6 hours) wait in the top level and are re-placed when it turns.
+class pg_timer_wheel {
+public:
+	using clock = std::chrono::steady_clock;
+
+	pg_timer_wheel();
+	~pg_timer_wheel();
+
+	pg_timer_wheel(const pg_timer_wheel&) = delete;
+	pg_timer_wheel& operator=(const pg_timer_wheel&) = delete;
+
+	// a deadline already passed expires on the next advance
+	void schedule(pg_timer& timer, clock::time_point deadline);
+
+	// moves the wheel to now and appends the expired timers
+	void advance(clock::time_point now, std::vector<pg_timer*>& expired);
+
+	// milliseconds until the wheel has work to do, -1 if no timer is armed.
+	// It may return before the next expiry, when a higher level bucket has to be moved down.
+	int next_timeout(clock::time_point now) const;
+
+private:
+	static constexpr int levels = 4;
+	static constexpr int bits = 6;
+	static constexpr int buckets = 1 << bits;
+
+	uint64_t to_tick(clock::time_point t, bool round_up) const;
+	void place(pg_timer& timer);
+	void cascade(int level, int index);
+	uint64_t next_tick() const;
+
+	clock::time_point _epoch;
+	uint64_t _now;
+	pg_timer _heads[levels][buckets];	// circular list sentinels
+	mutable uint64_t _occupied[levels];	// bit i is set when bucket i might not be empty, cleared lazily
+	bool empty(int level, int index) const;
+};
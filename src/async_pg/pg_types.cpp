@@ -0,0 +1,15 @@
+#include "pg_types.hpp"
+
+std::string pg_uuid::str() const {
+	static const char hex[] = "0123456789abcdef";
+	std::string s;
+	s.reserve(36);
+	for (std::size_t i = 0; i < bytes.size(); ++i) {
+		if (i == 4 || i == 6 || i == 8 || i == 10) {
+			s += '-';
+		}
+		s += hex[bytes[i] >> 4];
+		s += hex[bytes[i] & 0xf];
+	}
+	return s;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "libpq-fe.h"
+
+// Format the server sends the values of a result in. Binary values are decoded by pg_result::get
+// without parsing text; the simple query protocol only returns text, a binary query is always sent
+// with its parameters.
+enum class pg_format {
+	text = 0,
+	binary = 1
+};
+
+// type oids, see pg_type.dat
+constexpr Oid pg_bool_oid = 16;
+constexpr Oid pg_bytea_oid = 17;
+constexpr Oid pg_char_oid = 18;
+constexpr Oid pg_name_oid = 19;
+constexpr Oid pg_int8_oid = 20;
+constexpr Oid pg_int2_oid = 21;
+constexpr Oid pg_int4_oid = 23;
+constexpr Oid pg_text_oid = 25;
+constexpr Oid pg_json_oid = 114;
+constexpr Oid pg_xml_oid = 142;
+constexpr Oid pg_float4_oid = 700;
+constexpr Oid pg_float8_oid = 701;
+constexpr Oid pg_unknown_oid = 705;
+constexpr Oid pg_bpchar_oid = 1042;
+constexpr Oid pg_varchar_oid = 1043;
+constexpr Oid pg_timestamp_oid = 1114;
+constexpr Oid pg_timestamptz_oid = 1184;
+constexpr Oid pg_uuid_oid = 2950;
+
+// uuid column, see pg_result::get
+struct pg_uuid {
+	std::array<uint8_t, 16> bytes{};
+
+	// canonical form, 8-4-4-4-12 lowercase hex digits
+	std::string str() const;
+
+	bool operator==(const pg_uuid& o) const { return bytes == o.bytes; }
+	bool operator!=(const pg_uuid& o) const { return bytes != o.bytes; }
+};
+
+// bytea column in binary format, a view of the value inside the pg_result it was taken from
+class pg_bytes {
+public:
+	pg_bytes() = default;
+	pg_bytes(const uint8_t* data, std::size_t size) : _data(data), _size(size) {}
+
+	const uint8_t* data() const { return _data; }
+	std::size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+	const uint8_t* begin() const { return _data; }
+	const uint8_t* end() const { return _data + _size; }
+	uint8_t operator[](std::size_t i) const { return _data[i]; }
+
+private:
+	const uint8_t* _data = nullptr;
+	std::size_t _size = 0;
+};